@@ -0,0 +1,123 @@
+// Peak heap usage report for size tracking (make size): preloaded into the measured
+// process, counts glibc allocations and prints the peak at exit.
+#include <cstdio>
+#include <cstddef>
+#include <cerrno>
+#include <atomic>
+
+extern "C"{
+#include <malloc.h>
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t num, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+}
+
+static std::atomic<size_t> current_(0);
+static std::atomic<size_t> peak_(0);
+static std::atomic<size_t> allocations_(0);
+
+static void account(void *ptr)
+{
+	if(ptr == nullptr){
+		return;
+	}
+
+	size_t cur = current_ += malloc_usable_size(ptr);
+	size_t peak = peak_;
+	while(cur > peak && !peak_.compare_exchange_weak(peak, cur));
+	++allocations_;
+}
+
+extern "C"{
+
+void *malloc(size_t size)
+{
+	void *ptr = __libc_malloc(size);
+	account(ptr);
+	return ptr;
+}
+
+void *calloc(size_t num, size_t size)
+{
+	void *ptr = __libc_calloc(num, size);
+	account(ptr);
+	return ptr;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	if(ptr){
+		current_ -= malloc_usable_size(ptr);
+	}
+
+	void *res = __libc_realloc(ptr, size);
+	if(res == nullptr && ptr && size){
+		current_ += malloc_usable_size(ptr);	// old block is kept
+		return res;
+	}
+
+	account(res);
+	return res;
+}
+
+// Aligned blocks are released with free() too, so they must be counted as well
+void *memalign(size_t alignment, size_t size)
+{
+	void *ptr = __libc_memalign(alignment, size);
+	account(ptr);
+	return ptr;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	return memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	if(alignment % sizeof(void*) || (alignment & (alignment - 1)) || !alignment){
+		return EINVAL;
+	}
+
+	void *ptr = memalign(alignment, size);
+	if(ptr == nullptr && size){
+		return ENOMEM;
+	}
+
+	*memptr = ptr;
+	return 0;
+}
+
+void *valloc(size_t size)
+{
+	void *ptr = __libc_valloc(size);
+	account(ptr);
+	return ptr;
+}
+
+void *pvalloc(size_t size)
+{
+	void *ptr = __libc_pvalloc(size);
+	account(ptr);
+	return ptr;
+}
+
+void free(void *ptr)
+{
+	if(ptr){
+		current_ -= malloc_usable_size(ptr);
+	}
+	__libc_free(ptr);
+}
+
+__attribute__((destructor)) static void heap_report()
+{
+	fprintf(stderr, "peak heap: %zu bytes (%zu allocations)\n", peak_.load(), allocations_.load());
+}
+
+}
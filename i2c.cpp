@@ -5,6 +5,8 @@
 #include <cstring>
 #include <cerrno>
 #include <cstdio>
+#include <map>
+#include <chrono>
 
 extern "C"{
 #include <unistd.h>
@@ -15,6 +17,8 @@ extern "C"{
 }
 
 #include "i2c.hpp"
+#include "i2c_record.hpp"
+#include "trace.hpp"
 
 #define ARRAY_SIZE(a)   (sizeof(a) / sizeof(*a))
 
@@ -23,15 +27,332 @@ namespace hw{
 static std::string dev_ = "/dev/i2c-5"; 	// устройство i2c в ОС 
 static std::mutex mutex_; 					// синхронизация совместного доступа к шине i2c
 
+// Постоянно открытое устройство (под mutex_)
+static int fd_ = -1;
+static unsigned long funcs_ = 0;				// возможности адаптера (I2C_FUNCS)
+static int slave_ = -1;						// адрес, установленный I2C_SLAVE
+static transport transport_ = transport::AUTO;	// выбранный способ передачи
+static transport active_ = transport::AUTO;		// используемый способ передачи
+
+// Состояние устройств и автомат защиты (под health_mutex_, без блокировки шины)
+typedef std::chrono::steady_clock clock_type;
+
+struct device_state
+{
+	health h;
+	clock_type::time_point next_probe;
+};
+
+static std::mutex health_mutex_;
+static std::map<uint8_t, device_state> devices_;		// 8-битный адрес -> состояние
+static unsigned breaker_threshold_ = 0;
+static unsigned min_backoff_ms_ = 100;
+static unsigned max_backoff_ms_ = 10000;
+
 // Инициализация устройства I2C
 void i2c_init(const std::string &dev)
 {
 	std::lock_guard<std::mutex> lck(mutex_);
+
+	if(dev != dev_ && fd_ >= 0){
+		close(fd_);
+		fd_ = -1;
+	}
+
 	dev_ = dev;
 }
 
-// Интерфейс приемопередачи данных по I2C
-static bool i2c_rdwr(struct i2c_msg *msgs, int nmsgs)
+std::string i2c_get_dev()
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+	return dev_;
+}
+
+// Выбор способа передачи по возможностям адаптера. Вызывается под mutex_
+static void resolve_transport()
+{
+	if(transport_ != transport::AUTO){
+		active_ = transport_;
+	}
+	else if(funcs_ & I2C_FUNC_I2C){
+		active_ = transport::RDWR;
+	}
+	else if(funcs_ & (I2C_FUNC_SMBUS_WRITE_I2C_BLOCK | I2C_FUNC_SMBUS_WRITE_BYTE)){
+		active_ = transport::SMBUS;
+	}
+	else{
+		active_ = transport::RDWR;
+	}
+}
+
+// AUTO для открытого устройства выбирается сразу (возможности адаптера уже известны),
+// иначе - при открытии
+void i2c_set_transport(transport t)
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+	transport_ = t;
+	active_ = t;
+
+	if(fd_ >= 0){
+		resolve_transport();
+	}
+}
+
+// Открытие устройства (один раз). Вызывается под mutex_
+static void open_dev()
+{
+	if(fd_ >= 0){
+		return;
+	}
+
+	fd_ = open(dev_.c_str(), O_RDWR);
+	if(fd_ < 0){
+		throw std::runtime_error(std::string("open device '") + dev_ + "' failed: " + strerror(errno));
+	} 
+
+	if(ioctl(fd_, I2C_FUNCS, &funcs_) < 0){
+		funcs_ = 0;
+	}
+
+	slave_ = -1;
+	resolve_transport();
+}
+
+transport i2c_get_transport()
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+	open_dev();
+	return active_;
+}
+
+// Установка адреса для write() / SMBus. Вызывается под mutex_
+static bool set_slave(int addr)
+{
+	if(slave_ == addr){
+		return true;
+	}
+
+	// I2C_SLAVE_FORCE не используется: устройство может быть занято драйвером ядра
+	if(ioctl(fd_, I2C_SLAVE, addr) < 0){
+		slave_ = -1;
+		return false;
+	}
+
+	slave_ = addr;
+	return true;
+}
+
+static int smbus_access(char read_write, uint8_t command, int size, union i2c_smbus_data *data)
+{
+	struct i2c_smbus_ioctl_data args;
+	args.read_write = read_write;
+	args.command = command;
+	args.size = size;
+	args.data = data;
+
+	return ioctl(fd_, I2C_SMBUS, &args);
+}
+
+// Передача через write() / read() после I2C_SLAVE
+static bool xfer_plain(struct i2c_msg *msgs, int nmsgs)
+{
+	for(int i = 0; i < nmsgs; ++i){
+		if( !set_slave(msgs[i].addr) ){
+			return false;
+		}
+
+		ssize_t res = (msgs[i].flags & I2C_M_RD) ? read(fd_, msgs[i].buf, msgs[i].len) : write(fd_, msgs[i].buf, msgs[i].len);
+		if(res != msgs[i].len){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Передача SMBus-командами. Для расширителя порта байт команды - такой же выводимый байт,
+// поэтому последовательность байт делится на блоки: команда + до 32 байт данных.
+static bool xfer_smbus(struct i2c_msg *msgs, int nmsgs)
+{
+	for(int i = 0; i < nmsgs; ++i){
+		if( !set_slave(msgs[i].addr) ){
+			return false;
+		}
+
+		const uint8_t *buf = msgs[i].buf;
+		uint16_t len = msgs[i].len;
+
+		if(msgs[i].flags & I2C_M_RD){
+			for(uint16_t n = 0; n < len; ++n){
+				union i2c_smbus_data data;
+				if(smbus_access(I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data) < 0){
+					return false;
+				}
+				msgs[i].buf[n] = data.byte;
+			}
+			continue;
+		}
+
+		while(len){
+			if( (len > 1) && (funcs_ & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK) ){
+				uint16_t block_len = (len - 1 > I2C_SMBUS_BLOCK_MAX) ? I2C_SMBUS_BLOCK_MAX : (len - 1);
+				union i2c_smbus_data data;
+				data.block[0] = block_len;
+				memcpy(data.block + 1, buf + 1, block_len);
+
+				if(smbus_access(I2C_SMBUS_WRITE, buf[0], I2C_SMBUS_I2C_BLOCK_DATA, &data) < 0){
+					return false;
+				}
+
+				buf += block_len + 1;
+				len -= block_len + 1;
+			}
+			else{
+				if(smbus_access(I2C_SMBUS_WRITE, buf[0], I2C_SMBUS_BYTE, nullptr) < 0){
+					return false;
+				}
+
+				++buf;
+				--len;
+			}
+		}
+	}
+
+	return true;
+}
+
+void i2c_set_breaker(unsigned threshold, unsigned min_backoff_ms, unsigned max_backoff_ms)
+{
+	std::lock_guard<std::mutex> lck(health_mutex_);
+
+	breaker_threshold_ = threshold;
+	min_backoff_ms_ = min_backoff_ms ? min_backoff_ms : 1;
+	max_backoff_ms_ = (max_backoff_ms > min_backoff_ms_) ? max_backoff_ms : min_backoff_ms_;
+
+	if( !threshold ){
+		for(auto &dev : devices_){
+			dev.second.h.open = false;
+		}
+	}
+}
+
+health i2c_get_health(uint8_t slave_address)
+{
+	std::lock_guard<std::mutex> lck(health_mutex_);
+
+	auto it = devices_.find(slave_address);
+	if(it == devices_.end()){
+		return health();
+	}
+
+	health h = it->second.h;
+	h.probe_due = h.open && (clock_type::now() >= it->second.next_probe);
+	return h;
+}
+
+// Разрешена ли передача на адрес
+static bool breaker_admit(uint8_t addr)
+{
+	std::lock_guard<std::mutex> lck(health_mutex_);
+
+	if( !breaker_threshold_ ){
+		return true;
+	}
+
+	auto it = devices_.find(addr);
+	if(it == devices_.end() || !it->second.h.open){
+		return true;
+	}
+
+	++it->second.h.fast_fails;
+	return false;
+}
+
+// Учет результата транзакции
+static void breaker_account(uint8_t addr, bool ok, int err, uint32_t latency_us, bool probe)
+{
+	std::lock_guard<std::mutex> lck(health_mutex_);
+
+	device_state &dev = devices_[addr];
+	health &h = dev.h;
+
+	++h.transfers;
+	h.avg_latency_us = h.transfers == 1 ? latency_us : (h.avg_latency_us + (static_cast<int64_t>(latency_us) - h.avg_latency_us) / 8);
+	if(latency_us > h.max_latency_us){
+		h.max_latency_us = latency_us;
+	}
+
+	if(ok){
+		h.consecutive_failures = 0;
+		h.open = false;
+		h.backoff_ms = 0;
+		return;
+	}
+
+	++h.failures;
+	++h.consecutive_failures;
+
+	if(err == ENXIO || err == EREMOTEIO || err == EIO){
+		++h.nacks;
+	}
+	else if(err == ETIMEDOUT || err == EAGAIN){
+		++h.timeouts;
+	}
+
+	if( !breaker_threshold_ ){
+		return;
+	}
+
+	if( !h.open && h.consecutive_failures >= breaker_threshold_ ){
+		h.open = true;
+		h.backoff_ms = min_backoff_ms_;
+	}
+	else if(h.open && probe){
+		h.backoff_ms = (h.backoff_ms * 2 > max_backoff_ms_) ? max_backoff_ms_ : h.backoff_ms * 2;
+	}
+	else{
+		return;
+	}
+
+	dev.next_probe = clock_type::now() + std::chrono::milliseconds(h.backoff_ms);
+}
+
+// Проверка присутствия без данных (только адрес). Выходы расширителя порта не меняются.
+// Вызывается под mutex_
+static bool xfer_quick(uint16_t addr)
+{
+	switch(active_){
+		case transport::WRITE:{
+			uint8_t dummy = 0;
+			return set_slave(addr) && write(fd_, &dummy, 0) == 0;
+		}
+		case transport::SMBUS:
+			return set_slave(addr) && smbus_access(I2C_SMBUS_WRITE, 0, I2C_SMBUS_QUICK, nullptr) >= 0;
+		default:{
+			struct i2c_msg msg = {addr, 0, 0, nullptr};
+			struct i2c_rdwr_ioctl_data msgset = {&msg, 1};
+			return ioctl(fd_, I2C_RDWR, &msgset) >= 0;
+		}
+	}
+}
+
+// Адрес сообщения уже встречался раньше в этой транзакции
+static bool repeated_addr(const struct i2c_msg *msgs, int idx)
+{
+	for(int i = 0; i < idx; ++i){
+		if(msgs[i].addr == msgs[idx].addr){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Интерфейс приемопередачи данных по I2C.
+// Состояние учитывается по адресу каждого сообщения. При ошибке транзакции с несколькими
+// адресами неответившее устройство находится проверкой без данных (если адаптер ее
+// поддерживает): повтор данных исполнил бы команды дисплеев второй раз.
+static bool i2c_rdwr(struct i2c_msg *msgs, int nmsgs, bool probe = false)
 {
 	struct i2c_rdwr_ioctl_data msgset;
 	msgset.msgs = msgs;
@@ -41,20 +362,88 @@ static bool i2c_rdwr(struct i2c_msg *msgs, int nmsgs)
 		return false;
 	} 
 
+	// Неисправное устройство не занимает шину
+	bool multi = false;
+
+	for(int i = 0; i < nmsgs; ++i){
+		if(repeated_addr(msgs, i)){
+			continue;
+		}
+		multi = multi || (i > 0);
+
+		if( !probe && !breaker_admit(msgs[i].addr << 1) ){
+			errno = EHOSTDOWN;
+			return false;
+		}
+	}
+
+	TRACE_SPAN("i2c_rdwr", "bus");
+	uint64_t wait_begin = trace::enabled() ? trace::now_ns() : 0;
+
 	std::lock_guard<std::mutex> lck(mutex_);
 
-	int fd = open(dev_.c_str(), O_RDWR);
-	if(fd < 0){
-		throw std::runtime_error(std::string("open device '") + dev_ + "' failed: " + strerror(errno));
-	} 
+	if(wait_begin){
+		trace::record("mutex_wait", "bus", wait_begin, trace::now_ns());
+	}
 
-	if(ioctl(fd, I2C_RDWR, &msgset) < 0){
-		close(fd);
-		return false;
-	} 
+	i2c_record_msgs(msgs, nmsgs);
+	open_dev();
 
-	close(fd);
-	return true;
+	TRACE_SPAN("ioctl", "bus");
+
+	clock_type::time_point start = clock_type::now();
+	bool ok;
+
+	switch(active_){
+		case transport::WRITE: ok = xfer_plain(msgs, nmsgs); break;
+		case transport::SMBUS: ok = xfer_smbus(msgs, nmsgs); break;
+		default: ok = ioctl(fd_, I2C_RDWR, &msgset) >= 0; break;
+	}
+
+	int err = errno;
+	uint32_t latency_us = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - start).count();
+
+	if(ok || !multi){
+		for(int i = 0; i < nmsgs; ++i){
+			if( !repeated_addr(msgs, i) ){
+				breaker_account(msgs[i].addr << 1, ok, err, latency_us, probe);
+			}
+		}
+	}
+	else if(active_ != transport::RDWR || (funcs_ & I2C_FUNC_SMBUS_QUICK)){
+		for(int i = 0; i < nmsgs; ++i){
+			if(repeated_addr(msgs, i)){
+				continue;
+			}
+
+			clock_type::time_point quick_start = clock_type::now();
+			bool present = xfer_quick(msgs[i].addr);
+			int quick_err = errno;
+			uint32_t quick_us = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - quick_start).count();
+
+			breaker_account(msgs[i].addr << 1, present, quick_err, quick_us, probe);
+		}
+	}
+
+	errno = err;
+	return ok;
+}
+
+bool i2c_probe(uint8_t slave_address, uint8_t byte)
+{
+	struct i2c_msg msgs[1];
+
+	msgs[0].addr = slave_address >> 1;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &byte;
+
+	try{
+		return i2c_rdwr(msgs, ARRAY_SIZE(msgs), true);
+	}
+	catch(const std::exception &){
+		return false;
+	}
 }
 
 /**
@@ -120,6 +509,62 @@ void i2c_write_byte(uint8_t slave_address, uint8_t byte)
 	}
 }
 
+// Передача последовательности байт одной транзакцией (без адреса регистра)
+void i2c_write_bytes(uint8_t slave_address, const uint8_t *buf, uint16_t len)
+{
+	errno = 0;
+
+	struct i2c_msg msgs[1];
+
+	msgs[0].addr = slave_address >> 1;
+	msgs[0].flags = 0;
+	msgs[0].len = len;
+	msgs[0].buf = const_cast<uint8_t*>(buf);
+
+	if( !i2c_rdwr(msgs, ARRAY_SIZE(msgs)) ) {
+		throw std::runtime_error(std::string("i2c_write_bytes error (addr: " + std::to_string(slave_address) + ") - ") + strerror(errno)); 
+	}
+}
+
+// Передача одной последовательности байт нескольким устройствам.
+// Устройства с разомкнутым автоматом защиты пропускаются, остальные получают данные.
+void i2c_write_multi(const uint8_t *slave_addresses, size_t num, const uint8_t *buf, uint16_t len)
+{
+	struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+	size_t admitted = 0;
+
+	for(size_t done = 0; done < num; ){
+		size_t nmsgs = 0;
+
+		for( ; done < num && nmsgs < ARRAY_SIZE(msgs); ++done){
+			if( !breaker_admit(slave_addresses[done]) ){
+				continue;
+			}
+
+			msgs[nmsgs].addr = slave_addresses[done] >> 1;
+			msgs[nmsgs].flags = 0;
+			msgs[nmsgs].len = len;
+			msgs[nmsgs].buf = const_cast<uint8_t*>(buf);
+			++nmsgs;
+		}
+
+		if( !nmsgs ){
+			continue;
+		}
+
+		admitted += nmsgs;
+		errno = 0;
+
+		if( !i2c_rdwr(msgs, nmsgs) ) {
+			throw std::runtime_error(std::string("i2c_write_multi error (addr: " + std::to_string(msgs[0].addr << 1) + ") - ") + strerror(errno)); 
+		}
+	}
+
+	if( !admitted && num ){
+		throw std::runtime_error(std::string("i2c_write_multi error (addr: " + std::to_string(slave_addresses[0]) + ") - ") + strerror(EHOSTDOWN)); 
+	}
+}
+
 /**
   * @описание   Чтение данных по линии I2C
   * @параметры
@@ -2,12 +2,46 @@
 
 #include <cstdint>
 #include <string>
+#include <cstddef>
 
 namespace hw{
 
+// Способ передачи данных
+enum class transport : char
+{
+	AUTO = 0,	// по возможностям адаптера (I2C_FUNCS): RDWR, если поддерживается I2C, иначе SMBUS
+	RDWR,		// ioctl(I2C_RDWR)
+	WRITE,		// I2C_SLAVE + write() / read()
+	SMBUS,		// SMBus блочная (или побайтовая) запись
+};
+
+// Состояние устройства на шине (по адресу)
+struct health
+{
+	uint64_t transfers = 0;				// выполненные транзакции
+	uint64_t failures = 0;				// транзакции с ошибкой
+	uint64_t nacks = 0;					// из них: нет подтверждения (ENXIO, EREMOTEIO, EIO)
+	uint64_t timeouts = 0;				// из них: таймаут адаптера (ETIMEDOUT, EAGAIN)
+	uint64_t fast_fails = 0;			// отклонено автоматом защиты без обращения к шине
+	uint32_t consecutive_failures = 0;
+	uint32_t avg_latency_us = 0;		// скользящее среднее длительности транзакции
+	uint32_t max_latency_us = 0;
+	bool open = false;					// автомат защиты разомкнут: передача отклоняется
+	bool probe_due = false;				// наступило время проверки (i2c_probe)
+	uint32_t backoff_ms = 0;			// текущий интервал проверок
+};
+
 // Инициализация I2C с указанием используемого устройства (например, /dev/i2c-5)
 void i2c_init(const std::string &dev);
 
+// Используемое устройство I2C
+std::string i2c_get_dev();
+
+// Выбор способа передачи данных (по умолчанию AUTO)
+void i2c_set_transport(transport t);
+// Используемый способ передачи данных (открывает устройство)
+transport i2c_get_transport();
+
 /**
   * @описание	Передача данных по линии I2C 
   * @параметры
@@ -23,6 +57,28 @@ void i2c_write(uint8_t slave_address, uint16_t reg, const uint8_t *buf, uint16_t
 // Поддержка SMBus передачи
 void i2c_write_byte(uint8_t slave_address, uint8_t byte);
 
+// Передача последовательности байт одной транзакцией (например, поток байт расширителя порта)
+void i2c_write_bytes(uint8_t slave_address, const uint8_t *buf, uint16_t len);
+
+// Передача одной последовательности байт нескольким устройствам.
+// Сообщения для всех адресов объединяются в общие вызовы I2C_RDWR.
+// Устройства с разомкнутым автоматом защиты пропускаются (исключение - если пропущены все).
+// Ошибка транзакции учитывается для неответивших устройств (проверка без данных).
+void i2c_write_multi(const uint8_t *slave_addresses, size_t num, const uint8_t *buf, uint16_t len);
+
+// Автомат защиты: после threshold ошибок подряд передача на адрес отклоняется сразу
+// (исключение без ожидания таймаута адаптера и без блокировки шины), пока проверка
+// i2c_probe() не пройдет успешно. Интервал проверок удваивается от min_backoff_ms
+// до max_backoff_ms. threshold = 0 - автомат отключен (по умолчанию).
+void i2c_set_breaker(unsigned threshold, unsigned min_backoff_ms = 100, unsigned max_backoff_ms = 10000);
+
+// Статистика устройства
+health i2c_get_health(uint8_t slave_address);
+
+// Проверка присутствия устройства записью одного байта в обход автомата защиты.
+// Успешная запись замыкает автомат. Исключений не бросает.
+bool i2c_probe(uint8_t slave_address, uint8_t byte);
+
 /**
   * @описание   Чтение данных по линии I2C
   * @параметры
@@ -0,0 +1,225 @@
+#include <stdexcept>
+#include <string>
+#include <mutex>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+extern "C"{
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+}
+
+#include "i2c.hpp"
+#include "i2c_lock.hpp"
+#include "trace.hpp"
+
+#ifndef LCD_LOCK_DIR
+#define LCD_LOCK_DIR 		"/run/lcd1602"
+#endif
+
+// Не зависят от umask: каталог общий для всех пользователей (как /tmp),
+// файл открывается только на чтение (flock() не нужна запись)
+#define LOCK_DIR_MODE 		01777
+#define LOCK_FILE_MODE 		0644
+
+namespace hw{
+
+typedef std::chrono::steady_clock clock_type;
+
+// Блокировка устройства (адаптер + адрес) в процессе
+struct lock_entry
+{
+	std::recursive_mutex mutex;			// потоки процесса
+	unsigned depth = 0;					// вложенность у владельца (под mutex)
+	int fd = -1;						// файл блокировки (остается открытым)
+	clock_type::time_point acquired;
+	lock_stats stats;					// под stats_mutex_
+};
+
+static std::atomic<bool> locking_(false);
+static std::mutex entries_mutex_;
+// Ключ - путь файла блокировки: одинаковые адреса на разных адаптерах независимы
+static std::map<std::string, std::unique_ptr<lock_entry>> entries_;
+static std::mutex stats_mutex_;
+
+void i2c_set_locking(bool on)
+{
+	locking_ = on;
+}
+
+bool i2c_get_locking()
+{
+	return locking_;
+}
+
+static std::string lock_path(uint8_t slave_address, const std::string &dev)
+{
+	char addr[8];
+	snprintf(addr, sizeof(addr), "%02x", slave_address);
+
+	// /dev/i2c-0 -> i2c-0
+	size_t pos = dev.rfind('/');
+	std::string dev_name = (pos == std::string::npos) ? dev : dev.substr(pos + 1);
+
+	return std::string(LCD_LOCK_DIR) + "/" + dev_name + "-" + addr + ".lock";
+}
+
+static lock_entry& get_entry(const std::string &path)
+{
+	std::lock_guard<std::mutex> lck(entries_mutex_);
+
+	std::unique_ptr<lock_entry> &e = entries_[path];
+	if( !e ){
+		e.reset(new lock_entry);
+	}
+
+	return *e;
+}
+
+// Файл создается с явными правами, чтобы его могли открыть процессы других пользователей
+static int open_lock_file(const std::string &path)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd >= 0 || errno != ENOENT){
+		return fd;
+	}
+
+	if(mkdir(LCD_LOCK_DIR, LOCK_DIR_MODE) == 0){
+		chmod(LCD_LOCK_DIR, LOCK_DIR_MODE);
+	}
+
+	fd = open(path.c_str(), O_RDONLY | O_CREAT | O_EXCL | O_CLOEXEC, LOCK_FILE_MODE);
+	if(fd >= 0){
+		fchmod(fd, LOCK_FILE_MODE);
+		return fd;
+	}
+
+	// Создан другим процессом
+	if(errno == EEXIST){
+		fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+
+	return fd;
+}
+
+void i2c_lock(uint8_t slave_address)
+{
+	i2c_lock(slave_address, i2c_get_dev());
+}
+
+void i2c_lock(uint8_t slave_address, const std::string &dev)
+{
+	std::string path = lock_path(slave_address, dev);
+	lock_entry &e = get_entry(path);
+	clock_type::time_point start = clock_type::now();
+
+	// Сначала потоки процесса, затем другие процессы
+	bool contended = !e.mutex.try_lock();
+	if(contended){
+		TRACE_SPAN("lock_wait", "bus");
+		e.mutex.lock();
+	}
+
+	if(e.depth++){
+		return;
+	}
+
+	// Файл остается открытым, на каждую операцию только flock()
+	if(e.fd < 0){
+		e.fd = open_lock_file(path);
+		if(e.fd < 0){
+			int err = errno;
+			e.depth = 0;
+			e.mutex.unlock();
+			throw std::runtime_error("open lock file '" + path + "' failed: " + strerror(err));
+		}
+	}
+
+	if(flock(e.fd, LOCK_EX | LOCK_NB) < 0){
+		contended = true;
+		TRACE_SPAN("lock_wait", "bus");
+
+		while(flock(e.fd, LOCK_EX) < 0){
+			if(errno != EINTR){
+				int err = errno;
+				e.depth = 0;
+				e.mutex.unlock();
+				throw std::runtime_error("lock '" + path + "' failed: " + strerror(err));
+			}
+		}
+	}
+
+	e.acquired = clock_type::now();
+	uint32_t wait_us = std::chrono::duration_cast<std::chrono::microseconds>(e.acquired - start).count();
+
+	std::lock_guard<std::mutex> lck(stats_mutex_);
+	++e.stats.acquisitions;
+	if(contended){
+		++e.stats.contended;
+		e.stats.wait_total_us += wait_us;
+		if(wait_us > e.stats.wait_max_us){
+			e.stats.wait_max_us = wait_us;
+		}
+	}
+}
+
+// Дескриптор открыт с O_CLOEXEC: запущенные программы его не наследуют
+void i2c_unlock(uint8_t slave_address)
+{
+	i2c_unlock(slave_address, i2c_get_dev());
+}
+
+void i2c_unlock(uint8_t slave_address, const std::string &dev)
+{
+	lock_entry &e = get_entry(lock_path(slave_address, dev));
+
+	if(e.depth == 0){
+		return;
+	}
+
+	if(--e.depth == 0){
+		uint32_t hold_us = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - e.acquired).count();
+
+		flock(e.fd, LOCK_UN);
+
+		std::lock_guard<std::mutex> lck(stats_mutex_);
+		if(hold_us > e.stats.hold_max_us){
+			e.stats.hold_max_us = hold_us;
+		}
+	}
+
+	e.mutex.unlock();
+}
+
+lock_stats i2c_get_lock_stats(uint8_t slave_address)
+{
+	lock_entry &e = get_entry(lock_path(slave_address, i2c_get_dev()));
+
+	std::lock_guard<std::mutex> lck(stats_mutex_);
+	return e.stats;
+}
+
+bus_lock::bus_lock(uint8_t slave_address, bool on): addr(slave_address), locked(locking_ && on)
+{
+	if(this->locked){
+		this->dev = i2c_get_dev();
+		i2c_lock(this->addr, this->dev);
+	}
+}
+
+bus_lock::~bus_lock()
+{
+	if(this->locked){
+		i2c_unlock(this->addr, this->dev);
+	}
+}
+
+} // namespace hw
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace hw{
+
+/**
+  * Межпроцессная блокировка устройства (адаптер + адрес): flock() файла
+  * LCD_LOCK_DIR/<i2c-dev>-<addr>.lock (/run/lcd1602 по умолчанию).
+  * Удерживается на время операции с дисплеем (а не одной передачи), поэтому
+  * последовательности команд разных процессов не перемешиваются.
+  * Внутри процесса блокировка рекурсивная для потока-владельца, остальные потоки ждут.
+ */
+
+// Статистика ожидания блокировки (по адресу)
+struct lock_stats
+{
+	uint64_t acquisitions = 0;			// захваты (без вложенных)
+	uint64_t contended = 0;				// из них: с ожиданием
+	uint64_t wait_total_us = 0;
+	uint32_t wait_max_us = 0;
+	uint32_t hold_max_us = 0;			// максимальное время удержания
+};
+
+// Включение блокировок (по умолчанию выключены: bus_lock ничего не делает)
+void i2c_set_locking(bool on);
+bool i2c_get_locking();
+
+// Захват / освобождение блокировки адреса на используемом устройстве.
+// @исключения: std::runtime_error (нет доступа к файлу блокировки)
+void i2c_lock(uint8_t slave_address);
+void i2c_unlock(uint8_t slave_address);
+// Блокировка адреса на другом адаптере (например, при опросе шин)
+void i2c_lock(uint8_t slave_address, const std::string &dev);
+void i2c_unlock(uint8_t slave_address, const std::string &dev);
+
+// Статистика адреса на используемом устройстве
+lock_stats i2c_get_lock_stats(uint8_t slave_address);
+
+// Блокировка на время области видимости (если блокировки включены и on == true)
+class bus_lock
+{
+public:
+	explicit bus_lock(uint8_t slave_address, bool on = true);
+	~bus_lock();
+
+	bus_lock(const bus_lock&) = delete;
+	bus_lock& operator=(const bus_lock&) = delete;
+
+private:
+	uint8_t addr;
+	bool locked;
+	std::string dev;				// устройство на момент захвата
+};
+
+} // namespace hw
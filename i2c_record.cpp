@@ -0,0 +1,200 @@
+#include <stdexcept>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+
+extern "C"{
+#include <linux/i2c.h>
+}
+
+#include "i2c.hpp"
+#include "i2c_record.hpp"
+
+#define RECORD_MAGIC 		"I2CT"
+#define RECORD_VERSION 		1
+
+#define KIND_WRITE 			0
+#define KIND_READ 			1
+
+namespace hw{
+
+static std::mutex mutex_;								// синхронизация записи в файл
+static std::atomic<bool> recording_ { false };
+static FILE *fp_ = nullptr;
+static std::chrono::steady_clock::time_point last_;		// время предыдущей транзакции
+
+static void put_varint(uint64_t value)
+{
+	do{
+		uint8_t byte = value & 0x7F;
+		value >>= 7;
+		fputc(byte | (value ? 0x80 : 0), fp_);
+	}
+	while(value);
+}
+
+static bool get_varint(FILE *fp, uint64_t &value)
+{
+	value = 0;
+
+	for(int shift = 0; shift < 64; shift += 7){
+		int byte = fgetc(fp);
+		if(byte == EOF){
+			return false;
+		}
+
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+		if( !(byte & 0x80) ){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool i2c_record_start(const std::string &path)
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+
+	if(fp_){
+		fclose(fp_);
+	}
+
+	fp_ = fopen(path.c_str(), "wb");
+	if( !fp_ ){
+		recording_ = false;
+		return false;
+	}
+
+	fwrite(RECORD_MAGIC, 1, 4, fp_);
+	fputc(RECORD_VERSION, fp_);
+	last_ = std::chrono::steady_clock::now();
+	recording_ = true;
+
+	return true;
+}
+
+void i2c_record_stop()
+{
+	std::lock_guard<std::mutex> lck(mutex_);
+
+	recording_ = false;
+
+	if(fp_){
+		fclose(fp_);
+		fp_ = nullptr;
+	}
+}
+
+void i2c_record_msgs(const struct i2c_msg *msgs, int nmsgs)
+{
+	if( !recording_ ){
+		return;
+	}
+
+	std::lock_guard<std::mutex> lck(mutex_);
+
+	if( !fp_ ){
+		return;
+	}
+
+	auto now = std::chrono::steady_clock::now();
+	uint64_t delta = std::chrono::duration_cast<std::chrono::microseconds>(now - last_).count();
+	last_ = now;
+
+	// Запись регистра + чтение (i2c_read) - одна транзакция
+	bool is_read = (nmsgs == 2) && !(msgs[0].flags & I2C_M_RD) && (msgs[1].flags & I2C_M_RD);
+
+	if(is_read){
+		fputc(KIND_READ, fp_);
+		fputc(msgs[0].addr << 1, fp_);
+		put_varint(delta);
+		put_varint(msgs[0].len);
+		fwrite(msgs[0].buf, 1, msgs[0].len, fp_);
+		put_varint(msgs[1].len);
+		return;
+	}
+
+	// Несколько сообщений записи (например, i2c_write_multi) - отдельные транзакции
+	for(int i = 0; i < nmsgs; ++i){
+		fputc(KIND_WRITE, fp_);
+		fputc(msgs[i].addr << 1, fp_);
+		put_varint(i ? 0 : delta);
+		put_varint(msgs[i].len);
+		fwrite(msgs[i].buf, 1, msgs[i].len, fp_);
+	}
+}
+
+replay_stats i2c_replay(const std::string &path, bool real_time, bool mock)
+{
+	FILE *fp = fopen(path.c_str(), "rb");
+	if( !fp ){
+		throw std::runtime_error(std::string("open record '") + path + "' failed: " + strerror(errno));
+	}
+
+	std::unique_ptr<FILE, int(*)(FILE*)> guard(fp, fclose);
+
+	char magic[4];
+	if( (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)) || memcmp(magic, RECORD_MAGIC, sizeof(magic)) || 
+		(fgetc(fp) != RECORD_VERSION) ){
+		throw std::runtime_error(std::string("invalid record file: ") + path);
+	}
+
+	replay_stats stats;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> read_buf;
+	auto start = std::chrono::steady_clock::now();
+	auto due = start;
+
+	int kind;
+	while((kind = fgetc(fp)) != EOF){
+		int addr = fgetc(fp);
+		uint64_t delta = 0;
+		uint64_t len = 0;
+		uint64_t read_len = 0;
+
+		if( (addr == EOF) || !get_varint(fp, delta) || !get_varint(fp, len) || (len == 0) || (len > 0xFFFF) ){
+			throw std::runtime_error("truncated record file: " + path);
+		}
+
+		data.resize(len);
+		if( (fread(data.data(), 1, len, fp) != len) || ((kind == KIND_READ) && !get_varint(fp, read_len)) ){
+			throw std::runtime_error("truncated record file: " + path);
+		}
+
+		if(real_time){
+			due += std::chrono::microseconds(delta);
+			std::this_thread::sleep_until(due);
+		}
+
+		if( !mock ){
+			if(kind == KIND_READ){
+				uint16_t reg = (len == 2) ? ((data[0] << 8) | data[1]) : data[0];
+				read_buf.resize(read_len ? read_len : 1);
+				i2c_read(addr, reg, read_buf.data(), read_len);
+			}
+			else if(len == 1){
+				i2c_write_byte(addr, data[0]);
+			}
+			else{
+				i2c_write(addr, data[0], data.data() + 1, len - 1);
+			}
+		}
+
+		++stats.transactions;
+		stats.bytes += len + read_len;
+	}
+
+	stats.elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+} // namespace hw
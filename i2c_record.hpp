@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct i2c_msg;
+
+namespace hw{
+
+/**
+  * Формат записи трафика (все числа varint, кроме kind и addr):
+  *     заголовок: "I2CT" + версия (1 байт)
+  *     транзакция: kind (0 - запись, 1 - чтение), addr (8-битный адрес),
+  *                 задержка от предыдущей транзакции (мкс), длина, данные
+  *                 [для чтения - длина прочитанных данных]
+ */
+
+// Запись всех транзакций шины в файл path (до i2c_record_stop)
+bool i2c_record_start(const std::string &path);
+void i2c_record_stop();
+
+// Вызывается из i2c_rdwr под блокировкой шины (порядок записи совпадает с порядком на шине)
+void i2c_record_msgs(const struct i2c_msg *msgs, int nmsgs);
+
+struct replay_stats
+{
+	uint64_t transactions = 0;
+	uint64_t bytes = 0;
+	double elapsed_s = 0;
+};
+
+/**
+  * @описание   Воспроизведение записанного трафика
+  * @параметры
+  *     Входные:
+  *         path - файл записи
+  *         real_time - соблюдать исходные интервалы (иначе - максимальная скорость)
+  *         mock - не обращаться к шине (замер накладных расходов, проверка файла)
+  * @исключения: std::runtime_error
+ */
+replay_stats i2c_replay(const std::string &path, bool real_time, bool mock);
+
+} // namespace hw
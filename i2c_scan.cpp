@@ -0,0 +1,196 @@
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+
+extern "C"{
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+}
+
+#include "i2c_scan.hpp"
+#include "i2c_lock.hpp"
+
+// Выводы расширителя порта (см. lcd1602.cpp)
+#define PIN_RW   		( (uint8_t)(1 << 1) )
+#define PIN_EN 			( (uint8_t)(1 << 2) )
+#define PIN_BL 			( (uint8_t)(1 << 3) )
+#define DATA_PINS 		0xF0
+
+#define BUSY_FLAG 		0x80
+
+namespace hw{
+
+// 7-битные диапазоны адресов PCF8574 и PCF8574A
+static const uint8_t ranges_[][2] = { {0x20, 0x27}, {0x38, 0x3F} };
+
+static int smbus_access(int fd, char read_write, uint8_t command, int size, union i2c_smbus_data *data)
+{
+	struct i2c_smbus_ioctl_data args;
+	args.read_write = read_write;
+	args.command = command;
+	args.size = size;
+	args.data = data;
+
+	return ioctl(fd, I2C_SMBUS, &args);
+}
+
+// Запись байта в порт расширителя (SMBus send byte)
+static bool port_write(int fd, uint8_t byte)
+{
+	return smbus_access(fd, I2C_SMBUS_WRITE, byte, I2C_SMBUS_BYTE, nullptr) >= 0;
+}
+
+// Чтение выводов расширителя (SMBus receive byte)
+static bool port_read(int fd, uint8_t &byte)
+{
+	union i2c_smbus_data data;
+
+	if(smbus_access(fd, I2C_SMBUS_READ, 0, I2C_SMBUS_BYTE, &data) < 0){
+		return false;
+	}
+
+	byte = data.byte;
+	return true;
+}
+
+// Чтение полубайта при поднятом EN: D4..D7 подтягиваются к 1, если их никто не выставляет
+static bool read_nibble(int fd, uint8_t idle, uint8_t &nibble)
+{
+	uint8_t port;
+
+	if( !port_write(fd, idle | PIN_EN) || !port_read(fd, port) || !port_write(fd, idle) ){
+		return false;
+	}
+
+	nibble = port & DATA_PINS;
+	return true;
+}
+
+// Чтение флага занятости и счетчика адреса (RS = 0, R/W = 1) двумя полубайтами.
+// Чтение не меняет состояния контроллера, поэтому безопасно и в 8-битном режиме.
+// Без контроллера выводы данных остаются подтянутыми к 1.
+static bool identify_hd44780(int fd, uint8_t port, uint8_t &busy_address)
+{
+	uint8_t idle = DATA_PINS | PIN_RW | (port & PIN_BL);
+	uint8_t released, up, lo;
+	bool ok = port_write(fd, idle) && port_read(fd, released) &&
+		read_nibble(fd, idle, up) && read_nibble(fd, idle, lo);
+
+	// Прежнее состояние выводов (без строба)
+	port_write(fd, port & ~PIN_EN);
+
+	if( !ok || (released & DATA_PINS) != DATA_PINS ){
+		return false;
+	}
+
+	busy_address = up | (lo >> 4);
+
+	// Контроллер, не выполняющий команду, выставляет сброшенный флаг занятости (D7 = 0)
+	return up != DATA_PINS;
+}
+
+static void scan_adapter(scan_result &res, bool identify)
+{
+	int fd = open(res.dev.c_str(), O_RDWR);
+	if(fd < 0){
+		res.error = std::string("open failed: ") + strerror(errno);
+		return;
+	}
+
+	for(const auto &range : ranges_){
+		for(int addr = range[0]; addr <= range[1]; ++addr){
+			scan_device d = {static_cast<uint8_t>(addr << 1), device_kind::EXPANDER, 0, 0};
+
+			// I2C_SLAVE_FORCE не используется: устройство может быть занято драйвером ядра
+			if(ioctl(fd, I2C_SLAVE, addr) < 0){
+				if(errno == EBUSY){
+					d.kind = device_kind::BUSY;
+					res.devices.push_back(d);
+				}
+				continue;
+			}
+
+			// Быстрая проверка: чтение байта безопасно для расширителя порта
+			if( !port_read(fd, d.port) ){
+				continue;
+			}
+
+			// Чтения полубайтов не должны перемежаться с передачами работающих процессов
+			if(identify){
+				try{
+					hw::i2c_lock(d.addr, res.dev);
+				}
+				catch(const std::exception &){
+					res.devices.push_back(d);
+					continue;
+				}
+
+				if(identify_hd44780(fd, d.port, d.busy_address)){
+					d.kind = device_kind::HD44780;
+				}
+
+				hw::i2c_unlock(d.addr, res.dev);
+			}
+
+			res.devices.push_back(d);
+		}
+	}
+
+	close(fd);
+}
+
+std::vector<std::string> i2c_list_adapters()
+{
+	std::vector<std::pair<int, std::string>> found;
+
+	DIR *dir = opendir("/dev");
+	if(dir == nullptr){
+		return {};
+	}
+
+	struct dirent *ent;
+	while((ent = readdir(dir)) != nullptr){
+		if(strncmp(ent->d_name, "i2c-", 4) == 0){
+			found.emplace_back(atoi(ent->d_name + 4), std::string("/dev/") + ent->d_name);
+		}
+	}
+
+	closedir(dir);
+	std::sort(found.begin(), found.end());
+
+	std::vector<std::string> devs;
+	for(const auto &f : found){
+		devs.push_back(f.second);
+	}
+
+	return devs;
+}
+
+// Адаптеры независимы, поэтому время опроса определяется самым медленным из них
+std::vector<scan_result> i2c_scan(const std::vector<std::string> &devs, bool identify)
+{
+	std::vector<scan_result> results(devs.size());
+	std::vector<std::thread> workers;
+
+	for(size_t i = 0; i < devs.size(); ++i){
+		results[i].dev = devs[i];
+		workers.emplace_back(scan_adapter, std::ref(results[i]), identify);
+	}
+
+	for(std::thread &t : workers){
+		t.join();
+	}
+
+	return results;
+}
+
+} // namespace hw
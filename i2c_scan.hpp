@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace hw{
+
+// Тип устройства по результатам опроса
+enum class device_kind : char
+{
+	EXPANDER = 0,	// расширитель порта отвечает, дисплей не определен
+	HD44780,		// на выводах P4..P7 найден контроллер HD44780 (флаг занятости / счетчик адреса)
+	BUSY,			// адрес занят драйвером ядра
+};
+
+struct scan_device
+{
+	uint8_t addr;				// 8-битный адрес (как в LCD1602)
+	device_kind kind;
+	uint8_t port;				// состояние выводов расширителя до опроса
+	uint8_t busy_address;		// флаг занятости и счетчик адреса (для HD44780)
+};
+
+struct scan_result
+{
+	std::string dev;
+	std::string error;			// ошибка открытия адаптера (пусто, если нет)
+	std::vector<scan_device> devices;
+};
+
+// Адаптеры /dev/i2c-* по возрастанию номера
+std::vector<std::string> i2c_list_adapters();
+
+/**
+  * @описание   Поиск дисплеев на адресах PCF8574 (0x20..0x27) и PCF8574A (0x38..0x3F).
+  *             Адаптеры опрашиваются параллельно (поток на адаптер), каждый через
+  *             собственный дескриптор, без блокировки шины i2c_init() устройства.
+  * @параметры
+  *     Входные:
+  *         devs - адаптеры (например, результат i2c_list_adapters())
+  *         identify - определять HD44780 чтением флага занятости (на время опроса адрес
+  *                    блокируется i2c_lock()). Выводы расширителя временно переключаются
+  *                    и стробируется EN, что небезопасно для других нагрузок расширителя.
+  *                    Требует подключенного вывода R/W (P1): иначе строб EN запишет
+  *                    в контроллер полубайт команды. По умолчанию - только проверка присутствия.
+  * @результат  результаты в порядке devs
+ */
+std::vector<scan_result> i2c_scan(const std::vector<std::string> &devs, bool identify = false);
+
+} // namespace hw
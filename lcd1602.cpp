@@ -1,12 +1,21 @@
 #include <cstring>
 #include <cstdarg>
 
+#include <stdexcept>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+
 extern "C"{
     #include <unistd.h>
+    #include <time.h>
 }
 
 #include "i2c.hpp"
 #include "lcd1602.hpp"
+#include "lcd_encode.hpp"
+#include "i2c_lock.hpp"
+#include "trace.hpp"
 
 using namespace hw;
 
@@ -54,79 +63,190 @@ using namespace hw;
 #define LCD_5x10DOTS 			0x04
 #define LCD_5x8DOTS 			0x00
 
-// Index of user custom character bitmap
-#define B_NOIDX 				0xFF
+// Timings profiles location
+#ifndef LCD_TIMINGS_DIR
+#define LCD_TIMINGS_DIR 		"/var/lib/lcd1602"
+#endif
+
+// Readback verification
+#define BUSY_FLAG 				0x80
+#define BUSY_POLLS 				8	// busy flag polls before controller is considered dead
+#define CGRAM_SIZE 				0x40
+#define DDRAM_SIZE 				0x80
+
+// User custom characters
 #define B_MAXIDX				7
+#define B_LOCATIONS				8	// CGRAM locations number
+
+// Rewrite of this part of the screen cells is blanked by commit_frame(blank = true)
+#define FRAME_BLANK_PCT 		50
+
+// Data runs in one transaction: the longest command delay they are safe for
+// (two expander bytes at 100 kHz) and max run length
+#define RUN_GAP_US 				180
+#define RUN_MAX_BYTES 			32
+
+// Datasheet minimums of the initialization waits. They matter after power-up only,
+// so they can't be measured on a running controller and are never shortened below these.
+#define INIT_LONG_MIN_US 		4100
+#define INIT_SHORT_MIN_US 		100
+
+// saved_state layout version (increase on any change of the struct or its meaning)
+#define STATE_VERSION 			1
+
+// Printed for symbols missing in the display charset
+#define SYMB_UNKNOWN 			'?'
 
-// Russian chars hash-table (symbol unicode -> bitmap)
-std::unordered_map<wchar_t, LCD1602::custom_char> LCD1602::ru_symb_table { 
-	{1041, {B_NOIDX, {0b11111,0b10000,0b10000,0b11110,0b10001,0b10001,0b11110,0b00000}}}, // Б
-	{1043, {B_NOIDX, {0b11111,0b10000,0b10000,0b10000,0b10000,0b10000,0b10000,0b00000}}}, // Г
-	{1044, {B_NOIDX, {0b00110,0b01010,0b01010,0b01010,0b01010,0b01010,0b11111,0b10001}}}, // Д
-	{1046, {B_NOIDX, {0b10101,0b10101,0b10101,0b01110,0b10101,0b10101,0b10101,0b00000}}}, // Ж 
-	{1047, {B_NOIDX, {0b01110,0b10001,0b00001,0b00110,0b00001,0b10001,0b01110,0b00000}}}, // З
-	{1048, {B_NOIDX, {0b10001,0b10001,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}}, // И
-	{1049, {B_NOIDX, {0b10101,0b10001,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}}, // Й
-	{1051, {B_NOIDX, {0b00111,0b01001,0b01001,0b01001,0b01001,0b01001,0b10001,0b00000}}}, // Л
-	{1055, {B_NOIDX, {0b11111,0b10001,0b10001,0b10001,0b10001,0b10001,0b10001,0b00000}}}, // П
-	{1059, {B_NOIDX, {0b10001,0b10001,0b10001,0b01111,0b00001,0b10001,0b01110,0b00000}}}, // У
-	{1060, {B_NOIDX, {0b00100,0b01110,0b10101,0b10101,0b10101,0b01110,0b00100,0b00000}}}, // Ф
-	{1062, {B_NOIDX, {0b10010,0b10010,0b10010,0b10010,0b10010,0b10010,0b11111,0b00001}}}, // Ц
-	{1063, {B_NOIDX, {0b10001,0b10001,0b10001,0b01111,0b00001,0b00001,0b00001,0b00000}}}, // Ч
-	{1064, {B_NOIDX, {0b10001,0b10001,0b10001,0b10101,0b10101,0b10101,0b11111,0b00000}}}, // Ш
-	{1065, {B_NOIDX, {0b10001,0b10001,0b10001,0b10101,0b10101,0b10101,0b11111,0b00001}}}, // Щ
-	{1066, {B_NOIDX, {0b11000,0b01000,0b01000,0b01110,0b01001,0b01001,0b01110,0b00000}}}, // Ъ
-	{1067, {B_NOIDX, {0b10001,0b10001,0b10001,0b11101,0b10011,0b10011,0b11101,0b00000}}}, // Ы
-	{1068, {B_NOIDX, {0b10000,0b10000,0b10000,0b11110,0b10001,0b10001,0b11110,0b00000}}}, // Ь
-	{1069, {B_NOIDX, {0b01110,0b10001,0b00001,0b00111,0b00001,0b10001,0b01110,0b00000}}}, // Э
-	{1070, {B_NOIDX, {0b10010,0b10101,0b10101,0b11101,0b10101,0b10101,0b10010,0b00000}}}, // Ю
-	{1071, {B_NOIDX, {0b01111,0b10001,0b10001,0b01111,0b00101,0b01001,0b10001,0b00000}}}, // Я
-	{1073, {B_NOIDX, {0b00011,0b01100,0b10000,0b11110,0b10001,0b10001,0b01110,0b00000}}}, // б
-	{1074, {B_NOIDX, {0b00000,0b00000,0b11110,0b10001,0b11110,0b10001,0b11110,0b00000}}}, // в
-	{1075, {B_NOIDX, {0b00000,0b00000,0b11110,0b10000,0b10000,0b10000,0b10000,0b00000}}}, // г
-	{1076, {B_NOIDX, {0b00000,0b00000,0b00110,0b01010,0b01010,0b01010,0b11111,0b10001}}}, // д
-	{1105, {B_NOIDX, {0b01010,0b00000,0b01110,0b10001,0b11111,0b10000,0b01111,0b00000}}}, // ё
-	{1078, {B_NOIDX, {0b00000,0b00000,0b10101,0b10101,0b01110,0b10101,0b10101,0b00000}}}, // ж
-	{1079, {B_NOIDX, {0b00000,0b00000,0b01110,0b10001,0b00110,0b10001,0b01110,0b00000}}}, // з
-	{1080, {B_NOIDX, {0b00000,0b00000,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}}, // и
-	{1081, {B_NOIDX, {0b01010,0b00100,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}}, // й
-	{1082, {B_NOIDX, {0b00000,0b00000,0b10010,0b10100,0b11000,0b10100,0b10010,0b00000}}}, // к
-	{1083, {B_NOIDX, {0b00000,0b00000,0b00111,0b01001,0b01001,0b01001,0b10001,0b00000}}}, // л
-	{1084, {B_NOIDX, {0b00000,0b00000,0b10001,0b11011,0b10101,0b10001,0b10001,0b00000}}}, // м
-	{1085, {B_NOIDX, {0b00000,0b00000,0b10001,0b10001,0b11111,0b10001,0b10001,0b00000}}}, // н
-	{1087, {B_NOIDX, {0b00000,0b00000,0b11111,0b10001,0b10001,0b10001,0b10001,0b00000}}}, // п
-	{1090, {B_NOIDX, {0b00000,0b00000,0b11111,0b00100,0b00100,0b00100,0b00100,0b00000}}}, // т
-	{1092, {B_NOIDX, {0b00000,0b00000,0b00100,0b01110,0b10101,0b01110,0b00100,0b00000}}}, // ф
-	{1094, {B_NOIDX, {0b00000,0b00000,0b10010,0b10010,0b10010,0b10010,0b11111,0b00001}}}, // ц
-	{1095, {B_NOIDX, {0b00000,0b00000,0b10001,0b10001,0b01111,0b00001,0b00001,0b00000}}}, // ч
-	{1096, {B_NOIDX, {0b00000,0b00000,0b10101,0b10101,0b10101,0b10101,0b11111,0b00000}}}, // ш
-	{1097, {B_NOIDX, {0b00000,0b00000,0b10101,0b10101,0b10101,0b10101,0b11111,0b00001}}}, // щ
-	{1098, {B_NOIDX, {0b00000,0b00000,0b11000,0b01000,0b01110,0b01001,0b01110,0b00000}}}, // ъ
-	{1099, {B_NOIDX, {0b00000,0b00000,0b10001,0b10001,0b11101,0b10011,0b11101,0b00000}}}, // ы
-	{1100, {B_NOIDX, {0b00000,0b00000,0b10000,0b10000,0b11110,0b10001,0b11110,0b00000}}}, // ь
-	{1101, {B_NOIDX, {0b00000,0b00000,0b01110,0b10001,0b00111,0b10001,0b01110,0b00000}}}, // э
-	{1102, {B_NOIDX, {0b00000,0b00000,0b10010,0b10101,0b11101,0b10101,0b10010,0b00000}}}, // ю
-	{1103, {B_NOIDX, {0b00000,0b00000,0b01111,0b10001,0b01111,0b00101,0b01001,0b00000}}}, // я
-};
+// Waits shorter than this are done with spinning: sleeps overshoot by scheduler slice
+#define SPIN_THRESHOLD_NS 		100000L
+#define NSEC_PER_SEC 			1000000000L
+
+LCD1602::~LCD1602()
+{
+	this->wait_ready_deadline();
+	this->frame_unlock();
+}
+
+// Controller is busy for exec_us after the last Enable falling edge (end of transfer)
+void LCD1602::set_ready_deadline(uint32_t exec_us)
+{
+	clock_gettime(CLOCK_MONOTONIC, &this->ready_at);
+
+	this->ready_at.tv_nsec += static_cast<long>(exec_us) * 1000;
+	this->ready_at.tv_sec += this->ready_at.tv_nsec / NSEC_PER_SEC;
+	this->ready_at.tv_nsec %= NSEC_PER_SEC;
+}
+
+void LCD1602::wait_ready_deadline()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	long long left = (this->ready_at.tv_sec - now.tv_sec) * NSEC_PER_SEC + (this->ready_at.tv_nsec - now.tv_nsec);
+
+	// Deadline already passed during bus transfers or caller's work
+	if(left <= 0){
+		return;
+	}
+
+	TRACE_SPAN("wait_ready", "delay");
+
+	if(left > SPIN_THRESHOLD_NS){
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &this->ready_at, nullptr) == EINTR);
+		return;
+	}
+
+	do{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	}
+	while( (now.tv_sec < this->ready_at.tv_sec) || 
+		((now.tv_sec == this->ready_at.tv_sec) && (now.tv_nsec < this->ready_at.tv_nsec)) );
+}
 
 // The data must be manually clocked into the LCD controller by toggling
 // the CLK (Enable) line after the data has been placed on D4-D7
 // Display interface starts in 8-bit mode by default
 
+// All writes to the port expander go through this method
+void LCD1602::write_expander(const uint8_t *buf, uint16_t len)
+{
+	i2c_write_bytes(this->address, buf, len);
+}
+
+void LCD1602::copy_state(const LCD1602 &src)
+{
+	uint8_t addr = this->address;
+	bool locked = this->frame_locked;
+	*this = src;
+	this->address = addr;
+	this->frame_locked = locked;
+}
+
+void LCD1602::save_state(saved_state &st) const
+{
+	st = saved_state();
+
+	st.version = STATE_VERSION;
+	st.backlight_flag = this->backlight_flag;
+	st.display_function = this->display_function;
+	st.display_control = this->display_control;
+	st.display_mode = this->display_mode;
+	st.current_row = this->current_row;
+	st.current_col = this->current_col;
+	st.current_symb_idx = this->current_symb_idx;
+	st.delays = this->delays;
+
+	// Staged frame isn't applied to the controller, so its model is not saved
+	if( !this->state_known || this->frame_active ){
+		return;
+	}
+
+	st.state_known = 1;
+	st.ac_cgram = this->ac_cgram;
+	st.address_counter = this->address_counter;
+	memcpy(st.ddram, this->ddram, sizeof(st.ddram));
+	memcpy(st.cgram, this->cgram, sizeof(st.cgram));
+
+	for(size_t i = 0; i < DDRAM_SIZE; ++i){
+		st.ddram_known[i / 8] |= this->ddram_known.test(i) << (i % 8);
+	}
+	for(size_t i = 0; i < CGRAM_SIZE; ++i){
+		st.cgram_known[i / 8] |= this->cgram_known.test(i) << (i % 8);
+	}
+	for(size_t i = 0; i < B_LOCATIONS; ++i){
+		st.ru_symb_locations[i] = this->ru_symb_locations[i];
+	}
+}
+
+bool LCD1602::restore_state(const saved_state &st)
+{
+	if(st.version != STATE_VERSION){
+		return false;
+	}
+
+	this->frame_active = false;
+	this->backlight_flag = st.backlight_flag;
+	this->display_function = st.display_function;
+	this->display_control = st.display_control;
+	this->display_mode = st.display_mode;
+	this->current_row = st.current_row;
+	this->current_col = st.current_col;
+	this->current_symb_idx = st.current_symb_idx;
+	this->delays = st.delays;
+
+	this->state_known = st.state_known;
+	this->ac_cgram = st.ac_cgram;
+	this->address_counter = st.address_counter;
+	memcpy(this->ddram, st.ddram, sizeof(this->ddram));
+	memcpy(this->cgram, st.cgram, sizeof(this->cgram));
+
+	for(size_t i = 0; i < DDRAM_SIZE; ++i){
+		this->ddram_known.set(i, (st.ddram_known[i / 8] >> (i % 8)) & 1);
+	}
+	for(size_t i = 0; i < CGRAM_SIZE; ++i){
+		this->cgram_known.set(i, (st.cgram_known[i / 8] >> (i % 8)) & 1);
+	}
+	for(size_t i = 0; i < B_LOCATIONS; ++i){
+		this->ru_symb_locations[i] = static_cast<wchar_t>(st.ru_symb_locations[i]);
+	}
+
+	return true;
+}
+
 // 8-bit mode sending
 void LCD1602::send_8bit(uint8_t data)
 {
 	uint8_t data_arr[3];
 
+	this->wait_ready_deadline();
+
 	data_arr[0] = data;
 	data_arr[1] = data | PIN_EN;
 	data_arr[2] = data & ~PIN_EN;
 
-	for(size_t i = 0; i < sizeof(data_arr); ++i){
-		i2c_write_byte(this->address, data_arr[i]);
-	}
+	this->write_expander(data_arr, sizeof(data_arr));
 
-	usleep(50);
+	this->set_ready_deadline(this->delays.command);
 }
 
 // 4-bit mode sending
@@ -134,74 +254,379 @@ void LCD1602::send_4bit(uint8_t data, uint8_t flags)
 {
 	// PCF8574 connected with 4-bit interface to D4..D7 pins of HD44780
 	// so one data transfer must be made in two operations for 4-bit data
-	uint8_t up = data & 0xF0;
-	uint8_t lo = (data << 4) & 0xF0;
+	this->wait_ready_deadline();
 
 	uint8_t data_arr[4];
-	data_arr[0] = up | flags | this->backlight_flag | PIN_EN;
-	data_arr[1] = up | flags | this->backlight_flag;
-	data_arr[2] = lo | flags | this->backlight_flag | PIN_EN;
-	data_arr[3] = lo | flags | this->backlight_flag;
+	lcd_encode_4bit(&data, 1, flags | this->backlight_flag, data_arr);
 
-	for(size_t i = 0; i < sizeof(data_arr); ++i){
-		i2c_write_byte(this->address, data_arr[i]);
-	}
+	// All expander bytes in one transaction
+	this->write_expander(data_arr, sizeof(data_arr));
 
-	usleep(50);	// commands need > 37us to settle
+	this->set_ready_deadline(this->delays.command);	// commands need > 37us to settle
 } 
 
 // Data sending through i2c port expander
 void LCD1602::send_data(uint8_t data) 
 { 
+	if(this->frame_active){
+		if(this->ac_cgram){
+			this->frame_cgram[this->address_counter & (CGRAM_SIZE - 1)] = data;
+			this->frame_cgram_staged.set(this->address_counter & (CGRAM_SIZE - 1));
+		}
+		else{
+			this->frame_ddram[this->address_counter & (DDRAM_SIZE - 1)] = data;
+			this->frame_ddram_staged.set(this->address_counter & (DDRAM_SIZE - 1));
+		}
+
+		this->advance_address_counter();
+		return;
+	}
+
 	this->send_4bit(data, PIN_RS); 
+
+	if(this->state_known){
+		if(this->ac_cgram){
+			this->cgram[this->address_counter & (CGRAM_SIZE - 1)] = data;
+			this->cgram_known.set(this->address_counter & (CGRAM_SIZE - 1));
+		}
+		else{
+			this->ddram[this->address_counter & (DDRAM_SIZE - 1)] = data;
+			this->ddram_known.set(this->address_counter & (DDRAM_SIZE - 1));
+		}
+	}
+
+	this->advance_address_counter();
+}
+
+// Run of data bytes in one transaction. Next byte's upper nibble is latched two expander
+// bytes after the previous transfer, which is enough for the controller at PCF8574 bus
+// clock (<= 100 kHz) unless the command delay is longer.
+void LCD1602::send_data_run(const uint8_t *data, size_t len)
+{
+	if(this->frame_active || (this->delays.command > RUN_GAP_US)){
+		for(size_t i = 0; i < len; ++i){
+			this->send_data(data[i]);
+		}
+		return;
+	}
+
+	uint8_t buf[RUN_MAX_BYTES * 4];
+
+	while(len){
+		size_t n = (len > RUN_MAX_BYTES) ? RUN_MAX_BYTES : len;
+
+		this->wait_ready_deadline();
+		size_t bytes = lcd_encode_4bit(data, n, PIN_RS | this->backlight_flag, buf);
+		this->write_expander(buf, static_cast<uint16_t>(bytes));
+		this->set_ready_deadline(this->delays.command);
+
+		for(size_t i = 0; i < n; ++i){
+			if(this->state_known){
+				if(this->ac_cgram){
+					this->cgram[this->address_counter & (CGRAM_SIZE - 1)] = data[i];
+					this->cgram_known.set(this->address_counter & (CGRAM_SIZE - 1));
+				}
+				else{
+					this->ddram[this->address_counter & (DDRAM_SIZE - 1)] = data[i];
+					this->ddram_known.set(this->address_counter & (DDRAM_SIZE - 1));
+				}
+			}
+
+			this->advance_address_counter();
+		}
+
+		data += n;
+		len -= n;
+	}
+}
+
+// 4-bit mode reading. PCF8574 pins are quasi-bidirectional: D4..D7 must be written high
+// to be read. hw::i2c_read() writes 'reg' byte to the port before reading, so it is used
+// to raise EN and sample data lines in one transaction.
+uint8_t LCD1602::read_4bit(uint8_t flags)
+{
+	uint8_t idle = 0xF0 | PIN_RW | flags | this->backlight_flag;
+	uint8_t up = 0;
+	uint8_t lo = 0;
+
+	// Busy flag can be read at any time
+	if(flags & PIN_RS){
+		this->wait_ready_deadline();
+	}
+
+	i2c_write_byte(this->address, idle);
+	i2c_read(this->address, idle | PIN_EN, &up, 1);
+	i2c_write_byte(this->address, idle);
+	i2c_read(this->address, idle | PIN_EN, &lo, 1);
+	i2c_write_byte(this->address, idle);
+
+	return (up & 0xF0) | (lo >> 4);
+}
+
+uint8_t LCD1602::read_busy_address()
+{
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	return this->read_4bit(0);
+}
+
+// Reading also moves address counter according to the entry mode
+uint8_t LCD1602::read_data()
+{
+	uint8_t data = this->read_4bit(PIN_RS);
+	this->advance_address_counter();
+	return data;
+}
+
+// Returns false if the controller stays busy
+bool LCD1602::wait_ready()
+{
+	for(int i = 0; i < BUSY_POLLS; ++i){
+		if( !(this->read_busy_address() & BUSY_FLAG) ){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Moves address counter (DDRAM or CGRAM). Not sent if the model says it's already there.
+void LCD1602::set_address(bool cgram, uint8_t addr, bool force)
+{
+	// Staged frame: address is set by commit_frame() when needed
+	if(this->frame_active){
+		this->ac_cgram = cgram;
+		this->address_counter = addr;
+		return;
+	}
+
+	if( !force && this->state_known && (this->ac_cgram == cgram) && (this->address_counter == addr) ){
+		return;
+	}
+
+	this->send_command((cgram ? LCD_SETCGRAMADDR : LCD_SETDDRAMADDR) | addr);
+	this->ac_cgram = cgram;
+	this->address_counter = addr;
+}
+
+// Address counter is incremented (decremented) by the controller after each data write
+// according to the entry mode. In 2-line mode DDRAM addresses are 0x00..0x27 and 0x40..0x67.
+void LCD1602::advance_address_counter()
+{
+	bool increment = this->display_mode & LCD_ENTRYLEFT;
+
+	if(this->ac_cgram){
+		this->address_counter = (this->address_counter + (increment ? 1 : -1)) & 0x3F;
+		return;
+	}
+
+	if(increment){
+		if(this->address_counter == 0x27){
+			this->address_counter = 0x40;
+		}
+		else if(this->address_counter >= 0x67){
+			this->address_counter = 0x00;
+		}
+		else{
+			++this->address_counter;
+		}
+	}
+	else{
+		if(this->address_counter == 0x40){
+			this->address_counter = 0x27;
+		}
+		else if(this->address_counter == 0x00){
+			this->address_counter = 0x67;
+		}
+		else{
+			--this->address_counter;
+		}
+	}
 }
 
 void LCD1602::init(uint8_t lcd_addr, const std::string &i2c_dev) 
 {
+	TRACE_SPAN("LCD1602::init", "lcd");
+
+	// Lock file is chosen by the device and address set here
+	this->init_begin(lcd_addr, i2c_dev);
+	hw::bus_lock lck(lcd_addr, this->bus_locking());
+
+	// Sends wait for the step delays themselves
+	while(this->init_next());
+}
+
+void LCD1602::init_begin(uint8_t lcd_addr, const std::string &i2c_dev)
+{
+	// Lock of an unfinished frame belongs to the previous device and address
+	this->frame_unlock();
+
 	if( !i2c_dev.empty() ){
 		i2c_init(i2c_dev);
 	}
 
 	this->address = lcd_addr;
 
-	// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!according to datasheet, 
-	// we need at least 40ms after power rises above 2.7V before sending commands. 
-	//usleep(50000);
+	timings t;
+	if(load_timings(timings_path(i2c_get_dev(), lcd_addr), t)){
+		this->delays = t;
+	}
 
-	// We start in 8bit mode, try to set 4 bit mode
-	// 4-bit mode activation (according to the hitachi HD44780 datasheet figure 24, pg 46)
-	this->send_8bit(0b00110000);
-	usleep(4500);	// wait for more than 4.1ms
-	this->send_8bit(0b00110000);
-	usleep(150);	// wait for more than 100us
-	this->send_8bit(0b00110000);
+	this->reset_ru_symb_table();
+	this->readback = true;
+	this->init_reset();
+}
 
-	this->send_8bit(0b00100000);
-	// 4-bit interface finally. Now commands can be sent
+// Sends steps which are due, doesn't wait for the controller
+bool LCD1602::init_step()
+{
+	TRACE_SPAN("LCD1602::init_step", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
 
-	// Function set: 2 lines, 5x8 font format
-	this->display_function |= LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS;
-	this->send_command(LCD_FUNCTIONSET | this->display_function);
-	// usleep(2000);
+	while(this->init_stage >= 0){
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
 
-	// display & cursor home
-	this->return_home();
-	this->current_row = 0;
-	this->current_col = 0;
+		if( (now.tv_sec < this->ready_at.tv_sec) ||
+			((now.tv_sec == this->ready_at.tv_sec) && (now.tv_nsec < this->ready_at.tv_nsec)) ){
+			return false;
+		}
 
-	// display on, right shift, underline off, blink off
-	//this->send_command(0b00001100);
+		this->init_next();
+	}
 
-	// Set backlight ON by default
-	this->control(true, false, false);
-	this->display_mode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-	// Set the entry mode
-	this->send_command(LCD_ENTRYMODESET | this->display_mode);
+	return true;
+}
 
-	// Clear display 
-	this->clear();
+// Steps of the displays are interleaved: total time is close to one display init.
+// Display, that fails, is dropped from the sequence, the rest are initialized.
+std::vector<std::string> LCD1602::init_all(const std::vector<LCD1602*> &lcds)
+{
+	TRACE_SPAN("LCD1602::init_all", "lcd");
 
-	this->reset_ru_symb_table();
+	std::vector<std::string> errors(lcds.size());
+	std::vector<bool> failed(lcds.size(), false);
+
+	for(size_t i = 0; i < lcds.size(); ++i){
+		try{
+			lcds[i]->init_begin(lcds[i]->address);
+		}
+		catch(const std::exception &e){
+			errors[i] = e.what();
+			failed[i] = true;
+		}
+	}
+
+	for(;;){
+		struct timespec next = {0, 0};
+		bool pending = false;
+
+		for(size_t i = 0; i < lcds.size(); ++i){
+			LCD1602 *lcd = lcds[i];
+
+			if(failed[i]){
+				continue;
+			}
+
+			try{
+				if(lcd->init_step()){
+					continue;
+				}
+			}
+			catch(const std::exception &e){
+				errors[i] = e.what();
+				failed[i] = true;
+				lcd->invalidate_state();
+				continue;
+			}
+
+			if( !pending || (lcd->ready_at.tv_sec < next.tv_sec) ||
+				((lcd->ready_at.tv_sec == next.tv_sec) && (lcd->ready_at.tv_nsec < next.tv_nsec)) ){
+				next = lcd->ready_at;
+			}
+			pending = true;
+		}
+
+		if( !pending ){
+			return errors;
+		}
+
+		TRACE_SPAN("wait_ready", "delay");
+		while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR);
+	}
+}
+
+// Controller initialization sequence
+void LCD1602::init_controller()
+{
+	this->init_reset();
+	while(this->init_next());
+}
+
+void LCD1602::init_reset()
+{
+	this->frame_unlock();
+	this->frame_active = false;
+	this->state_known = false;
+	this->cgram_known.reset();
+	this->verify_pos = 0;
+	this->init_stage = 0;
+}
+
+// One controller transfer of the initialization sequence. Returns false after the last one.
+bool LCD1602::init_next()
+{
+	// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!according to datasheet, 
+	// we need at least 40ms after power rises above 2.7V before sending commands. 
+	//usleep(50000);
+
+	switch(this->init_stage++){
+		// We start in 8bit mode, try to set 4 bit mode
+		// 4-bit mode activation (according to the hitachi HD44780 datasheet figure 24, pg 46)
+		case 0:
+			this->send_8bit(0b00110000);
+			this->set_ready_deadline(this->delays.init_long);	// wait for more than 4.1ms
+			break;
+		case 1:
+			this->send_8bit(0b00110000);
+			this->set_ready_deadline(this->delays.init_short);	// wait for more than 100us
+			break;
+		case 2:
+			this->send_8bit(0b00110000);
+			break;
+		case 3:
+			this->send_8bit(0b00100000);
+			// 4-bit interface finally. Now commands can be sent
+			break;
+		case 4:
+			// Function set: 2 lines, 5x8 font format
+			this->display_function |= LCD_4BITMODE | LCD_2LINE | LCD_5x8DOTS;
+			this->send_command(LCD_FUNCTIONSET | this->display_function);
+			break;
+		case 5:
+			// display & cursor home
+			this->return_home();
+			break;
+		case 6:
+			// Set backlight ON by default
+			this->control(true, false, false);
+			break;
+		case 7:
+			this->display_mode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
+			// Set the entry mode
+			this->send_command(LCD_ENTRYMODESET | this->display_mode);
+			break;
+		default:
+			// Clear display 
+			this->clear();
+
+			// From now on the controller state is fully defined by the sent commands
+			this->state_known = true;
+			this->init_stage = -1;
+			return false;
+	}
+
+	return true;
 }
 
 // Control the backlight, cursor, and blink
@@ -209,6 +634,12 @@ void LCD1602::init(uint8_t lcd_addr, const std::string &i2c_dev)
 // from the blinking block option
 void LCD1602::control(bool backlight, bool cursor, bool blink)
 {
+	TRACE_SPAN("LCD1602::control", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	uint8_t prev_control = this->display_control;
+	uint8_t prev_backlight = this->backlight_flag;
+
 	// Enable backlight ?
 	if(backlight){
 		this->backlight_flag = LCD_BACKLIGHT;
@@ -235,6 +666,14 @@ void LCD1602::control(bool backlight, bool cursor, bool blink)
 		this->display_control &= ~LCD_BLINKON;
 	}
 
+	if(this->state_known && (prev_control == this->display_control)){
+		// Backlight is not a controller state - it's the expander output pin
+		if(prev_backlight != this->backlight_flag){
+			this->write_expander(&this->backlight_flag, 1);
+		}
+		return;
+	}
+
 	this->send_command(LCD_DISPLAYCONTROL | this->display_control);
 }
 
@@ -251,17 +690,28 @@ std::tuple<bool, bool, bool> LCD1602::get_control() const
 // Scroll the entire display without changing the RAM
 void LCD1602::scroll_left(void) 
 {
+	TRACE_SPAN("LCD1602::scroll_left", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	this->send_command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
 }
 
 void LCD1602::scroll_right(void) 
 {
+	TRACE_SPAN("LCD1602::scroll_right", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	this->send_command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
 // Set text direction
 void LCD1602::left_to_right(bool on_off) 
 {
+	TRACE_SPAN("LCD1602::left_to_right", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	uint8_t prev_mode = this->display_mode;
+
 	if(on_off){
 		// for text that flows Left to Right
 		this->display_mode |= LCD_ENTRYLEFT;
@@ -270,6 +720,10 @@ void LCD1602::left_to_right(bool on_off)
 		// for text that flows Right to Left
 		this->display_mode &= ~LCD_ENTRYLEFT;
 	}
+
+	if(this->state_known && (prev_mode == this->display_mode)){
+		return;
+	}
 	
 	this->send_command(LCD_ENTRYMODESET | this->display_mode);
 }
@@ -277,6 +731,11 @@ void LCD1602::left_to_right(bool on_off)
 // This will 'right justify' text from the cursor
 void LCD1602::autoscroll(bool on_off) 
 {
+	TRACE_SPAN("LCD1602::autoscroll", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	uint8_t prev_mode = this->display_mode;
+
 	if(on_off){
 		this->display_mode |= LCD_ENTRYSHIFTINCREMENT;
 	}
@@ -284,6 +743,10 @@ void LCD1602::autoscroll(bool on_off)
 	else{
 		this->display_mode &= ~LCD_ENTRYSHIFTINCREMENT; // noautoscroll
 	}
+
+	if(this->state_known && (prev_mode == this->display_mode)){
+		return;
+	}
 	
 	this->send_command(LCD_ENTRYMODESET | this->display_mode);
 }
@@ -291,26 +754,176 @@ void LCD1602::autoscroll(bool on_off)
 // Allows to fill the first 8 CGRAM locations with custom characters
 void LCD1602::user_char_create(uint8_t location, const uint8_t *charmap) 
 {
+	TRACE_SPAN("LCD1602::user_char_create", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	location &= 0x07; // we only have 8 locations (0-7)
-	this->send_command(LCD_SETCGRAMADDR | (location << 3));
+	uint8_t cgram_addr = location << 3;
+	bool increment = this->display_mode & LCD_ENTRYLEFT;
+
+	// Only changed rows of the known bitmap are written (e.g. animation frames).
+	// Address setting costs one transfer as well as one row, so single unchanged
+	// rows between changed ones are written through.
+	if(this->state_known && increment && !this->frame_active){
+		auto changed = [&](uint8_t row){
+			uint8_t addr = cgram_addr + row;
+			return !this->cgram_known.test(addr) || (this->cgram[addr] != charmap[row]);
+		};
+
+		uint8_t row = 0;
+		while(row < 8){
+			if( !changed(row) ){
+				++row;
+				continue;
+			}
+
+			uint8_t last = row;
+			for(uint8_t next = row + 1; next < 8; ++next){
+				if(changed(next)){
+					last = next;
+				}
+				else if( !(next + 1 < 8 && changed(next + 1)) ){
+					break;
+				}
+			}
+
+			// Consecutive rows and locations are written without address setting
+			this->set_address(true, cgram_addr + row);
+
+			for( ; row <= last; ++row){
+				this->send_data(charmap[row]);
+			}
+		}
+		return;
+	}
+
+	this->set_address(true, cgram_addr, !increment);
 
 	for (int i = 0; i < 8; ++i) {
 		this->send_data(charmap[i]);
 	}
 }
 
+// Reserves top CGRAM locations for external renderers.
+// RU symbols table is reset, because its symbols could be placed at reserved locations.
+uint8_t LCD1602::reserve_user_chars(uint8_t count)
+{
+	if(count > B_MAXIDX){
+		count = B_MAXIDX;
+	}
+
+	this->user_chars_app = static_cast<uint8_t>(0xFF << (B_LOCATIONS - count));
+	this->update_user_chars();
+
+	return B_LOCATIONS - count;
+}
+
+uint8_t LCD1602::acquire_user_chars(uint8_t count, uint8_t &first)
+{
+	if(count > B_MAXIDX){
+		count = B_MAXIDX;
+	}
+
+	// Location 0 is always left for RU symbols
+	for( ; count; --count){
+		uint8_t block = static_cast<uint8_t>((1 << count) - 1);
+
+		for(int loc = B_LOCATIONS - count; loc > 0; --loc){
+			if( !((this->user_chars_app | this->user_chars_owned) & (block << loc)) ){
+				this->user_chars_owned |= block << loc;
+				this->update_user_chars();
+				first = static_cast<uint8_t>(loc);
+				return count;
+			}
+		}
+	}
+
+	first = B_LOCATIONS;
+	return 0;
+}
+
+void LCD1602::release_user_chars(uint8_t first, uint8_t count)
+{
+	if( !count || (first + count > B_LOCATIONS) ){
+		return;
+	}
+
+	this->user_chars_owned &= ~static_cast<uint8_t>(((1 << count) - 1) << first);
+	this->update_user_chars();
+}
+
+// RU symbols use locations below the lowest reserved one
+void LCD1602::update_user_chars()
+{
+	uint8_t mask = this->user_chars_app | this->user_chars_owned;
+	uint8_t lowest = 0;
+
+	while((lowest < B_LOCATIONS) && !(mask & (1 << lowest))){
+		++lowest;
+	}
+
+	uint8_t count = B_LOCATIONS - lowest;
+
+	if(count != this->user_chars_reserved){
+		this->user_chars_reserved = count;
+		this->reset_ru_symb_table();
+	}
+}
+
 // Prints user-characters from CGRAM memory (location 0-7)
 void LCD1602::user_char_print(uint8_t location)
 {
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	this->send_data(location);
 	++current_col;
 }
 
+void LCD1602::print_codes(const uint8_t *codes, size_t len)
+{
+	TRACE_SPAN("LCD1602::print_codes", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	this->send_data_run(codes, len);
+	this->current_col += len;
+}
+
 // Clears entire display and sets DDRAM address 0 in address counter
 void LCD1602::clear()
 {
+	TRACE_SPAN("LCD1602::clear", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	// Staged clear writes spaces, so only cells that are not blank already are sent
+	if(this->frame_active){
+		for(uint8_t i = 0; i < 0x28; ++i){
+			this->frame_ddram[i] = ' ';
+			this->frame_ddram[0x40 + i] = ' ';
+			this->frame_ddram_staged.set(i);
+			this->frame_ddram_staged.set(0x40 + i);
+		}
+		this->ac_cgram = false;
+		this->address_counter = 0;
+		this->current_row = 0;
+		this->current_col = 0;
+		return;
+	}
+
 	this->send_command(LCD_CLEARDISPLAY);
-	usleep(2000); // this command takes a long time
+	this->set_ready_deadline(this->delays.clear); // this command takes a long time
+
+	// Clear also sets increment mode (I/D = 1)
+	this->display_mode |= LCD_ENTRYLEFT;
+	memset(this->ddram, ' ', sizeof(this->ddram));
+	this->ddram_known.reset();
+	for(uint8_t i = 0; i < 0x28; ++i){
+		this->ddram_known.set(i);
+		this->ddram_known.set(0x40 + i);
+	}
+	this->ac_cgram = false;
+	this->address_counter = 0;
+	this->current_row = 0;
+	this->current_col = 0;
 }
 
 // Return home sets DDRAM address 0 into the address counter, and returns the display to its 
@@ -318,24 +931,526 @@ void LCD1602::clear()
 // blinking go to the left edge of the display (in the first line if 2 lines are displayed).
 void LCD1602::return_home()
 {
+	TRACE_SPAN("LCD1602::return_home", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	this->send_command(LCD_RETURNHOME);
-	usleep(2000); // this command takes a long time
+	this->set_ready_deadline(this->delays.clear); // this command takes a long time
+
+	this->frame_bus_cgram = false;
+	this->frame_bus_ac = 0;
+	this->ac_cgram = false;
+	this->address_counter = 0;
+	this->current_row = 0;
+	this->current_col = 0;
 }
 
 // Set the LCD cursor position
 void LCD1602::set_cursor(uint8_t row, uint8_t col)
 {
+	TRACE_SPAN("LCD1602::set_cursor", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	uint8_t row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
 
 	if(row > this->num_rows){
 		row = this->num_rows - 1;
 	} 
 
-	this->send_command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+	uint8_t ddram_addr = col + row_offsets[row];
+
+	// Skip if auto-increment has already moved address counter to the position
+	this->set_address(false, ddram_addr);
+
 	this->current_row = row;
     this->current_col = col;
 }
 
+// --- Frame transactions ---
+
+void LCD1602::begin_frame()
+{
+	if(this->frame_active){
+		return;
+	}
+
+	// Other processes wait for the whole frame
+	if(hw::i2c_get_locking() && this->bus_locking()){
+		hw::i2c_lock(this->address);
+		this->frame_locked = true;
+	}
+
+	this->frame_active = true;
+	this->frame_bus_cgram = this->ac_cgram;
+	this->frame_bus_ac = this->address_counter;
+	this->frame_row = this->current_row;
+	this->frame_col = this->current_col;
+	this->frame_ddram_staged.reset();
+	this->frame_cgram_staged.reset();
+	this->frame_symb_idx = this->current_symb_idx;
+	memcpy(this->frame_ru_symb_locations, this->ru_symb_locations, sizeof(this->ru_symb_locations));
+}
+
+void LCD1602::abort_frame()
+{
+	if( !this->frame_active ){
+		return;
+	}
+
+	this->frame_active = false;
+	this->ac_cgram = this->frame_bus_cgram;
+	this->address_counter = this->frame_bus_ac;
+	this->current_row = this->frame_row;
+	this->current_col = this->frame_col;
+	// Glyph uploads of the frame are dropped with it
+	this->current_symb_idx = this->frame_symb_idx;
+	memcpy(this->ru_symb_locations, this->frame_ru_symb_locations, sizeof(this->ru_symb_locations));
+	this->frame_unlock();
+}
+
+void LCD1602::frame_unlock()
+{
+	if(this->frame_locked){
+		this->frame_locked = false;
+		hw::i2c_unlock(this->address);
+	}
+}
+
+// Writes dirty cells (listed in address counter order) in runs. Address setting costs
+// one transfer as well as one data write, so single clean cells inside a run are
+// written through if their contents are known.
+void LCD1602::write_cells(bool cgram, const frame_cell *cells, size_t num)
+{
+	bool increment = this->display_mode & LCD_ENTRYLEFT;
+	size_t i = 0;
+
+	while(i < num){
+		if( !cells[i].dirty ){
+			++i;
+			continue;
+		}
+
+		size_t last = i;
+		for(size_t next = i + 1; increment && next < num; ++next){
+			if(cells[next].dirty){
+				last = next;
+			}
+			else if( (cells[next].value < 0) || !(next + 1 < num && cells[next + 1].dirty) ){
+				break;
+			}
+		}
+
+		this->set_address(cgram, cells[i].addr);
+
+		uint8_t run[DDRAM_SIZE];
+		size_t len = 0;
+		for( ; i <= last; ++i){
+			run[len++] = static_cast<uint8_t>(cells[i].value);
+		}
+		this->send_data_run(run, len);
+	}
+}
+
+void LCD1602::commit_frame(bool blank)
+{
+	TRACE_SPAN("LCD1602::commit_frame", "lcd");
+
+	if( !this->frame_active ){
+		return;
+	}
+
+	// Frame lock is passed to the scoped one, so it's released on errors too
+	hw::bus_lock lck(this->address, this->bus_locking());
+	this->frame_unlock();
+	this->frame_active = false;
+
+	// Staged address counter is restored after the commit
+	bool end_cgram = this->ac_cgram;
+	uint8_t end_ac = this->address_counter;
+	this->ac_cgram = this->frame_bus_cgram;
+	this->address_counter = this->frame_bus_ac;
+
+	// CGRAM first: DDRAM cells of the frame may use new bitmaps
+	frame_cell cg_cells[CGRAM_SIZE];
+	for(uint8_t addr = 0; addr < CGRAM_SIZE; ++addr){
+		frame_cell &c = cg_cells[addr];
+		bool known = this->state_known && this->cgram_known.test(addr);
+
+		c.addr = addr;
+		c.dirty = this->frame_cgram_staged.test(addr) && ( !known || this->cgram[addr] != this->frame_cgram[addr] );
+		c.value = this->frame_cgram_staged.test(addr) ? this->frame_cgram[addr] : (known ? this->cgram[addr] : -1);
+	}
+	this->write_cells(true, cg_cells, CGRAM_SIZE);
+
+	// DDRAM lines in address counter order: 0x00..0x27, 0x40..0x67
+	frame_cell dd_cells[0x50];
+	size_t dirty = 0;
+	for(uint8_t i = 0; i < 0x50; ++i){
+		frame_cell &c = dd_cells[i];
+		uint8_t addr = (i < 0x28) ? i : (0x40 + i - 0x28);
+		bool known = this->state_known && this->ddram_known.test(addr);
+
+		c.addr = addr;
+		c.dirty = this->frame_ddram_staged.test(addr) && ( !known || this->ddram[addr] != this->frame_ddram[addr] );
+		c.value = this->frame_ddram_staged.test(addr) ? this->frame_ddram[addr] : (known ? this->ddram[addr] : -1);
+		dirty += c.dirty;
+	}
+
+	bool blanked = blank && (this->display_control & LCD_DISPLAYON) && 
+		(dirty * 100 >= static_cast<size_t>(this->num_rows) * this->num_cols * FRAME_BLANK_PCT);
+
+	if(blanked){
+		this->send_command(LCD_DISPLAYCONTROL | (this->display_control & ~LCD_DISPLAYON));
+	}
+
+	this->write_cells(false, dd_cells, 0x50);
+
+	if(blanked){
+		this->send_command(LCD_DISPLAYCONTROL | this->display_control);
+	}
+
+	this->set_address(end_cgram, end_ac);
+}
+
+// --- Readback verification ---
+
+// Cells are checked in order: DDRAM, then CGRAM. Only cells known by the model are checked.
+size_t LCD1602::verify_step(size_t max_cells)
+{
+	TRACE_SPAN("LCD1602::verify_step", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	if( !this->readback || !this->state_known || this->frame_active ){
+		return 0;
+	}
+
+	if( !this->wait_ready() ){
+		this->recover();
+
+		// Busy flag always reads 1 with R/W tied to ground. Reads were written into
+		// the controller then, so it's repainted once more.
+		if( !this->wait_ready() ){
+			this->readback = false;
+			this->recover();
+		}
+		return 0;
+	}
+
+	bool saved_cgram = this->ac_cgram;
+	uint8_t saved_ac = this->address_counter;
+	uint8_t saved_mode = this->display_mode;
+	size_t repaired = 0;
+	size_t total = DDRAM_SIZE + CGRAM_SIZE;
+	bool addressed = false;
+
+	// Reading in increment mode only, to follow the cells order
+	if( !(this->display_mode & LCD_ENTRYLEFT) ){
+		this->display_mode |= LCD_ENTRYLEFT;
+		this->send_command(LCD_ENTRYMODESET | this->display_mode);
+	}
+
+	for(size_t n = 0; (n < total) && max_cells; ++n){
+		size_t pos = this->verify_pos;
+		this->verify_pos = (this->verify_pos + 1) % total;
+
+		bool is_cgram = pos >= DDRAM_SIZE;
+		uint8_t addr = is_cgram ? (pos - DDRAM_SIZE) : pos;
+
+		if( is_cgram ? !this->cgram_known.test(addr) : !this->ddram_known.test(addr) ){
+			continue;
+		}
+
+		--max_cells;
+		uint8_t expected = is_cgram ? this->cgram[addr] : this->ddram[addr];
+
+		// First read after a data write returns garbage without a fresh address set
+		this->set_address(is_cgram, addr, !addressed);
+		addressed = true;
+		uint8_t actual = this->read_data();
+
+		// Only 5 low bits of CGRAM bytes are meaningful
+		if( is_cgram ? ((actual ^ expected) & 0x1F) == 0 : (actual == expected) ){
+			continue;
+		}
+
+		// Rewrite and check again. Still wrong - controller is not responding properly.
+		this->set_address(is_cgram, addr, true);
+		this->send_data(expected);
+		this->set_address(is_cgram, addr, true);
+		actual = this->read_data();
+
+		if( is_cgram ? ((actual ^ expected) & 0x1F) != 0 : (actual != expected) ){
+			this->display_mode = saved_mode;
+			this->ac_cgram = saved_cgram;
+			this->address_counter = saved_ac;
+			this->recover();
+			return repaired;
+		}
+
+		++repaired;
+	}
+
+	if(saved_mode != this->display_mode){
+		this->display_mode = saved_mode;
+		this->send_command(LCD_ENTRYMODESET | this->display_mode);
+	}
+
+	// Reads move the address counter of the read controller only (first member of
+	// LCDMirror), the cached one can't be trusted after them
+	this->set_address(saved_cgram, saved_ac, addressed);
+	return repaired;
+}
+
+void LCD1602::recover()
+{
+	TRACE_SPAN("LCD1602::recover", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	// Save the model - initialization resets it
+	uint8_t saved_ddram[DDRAM_SIZE];
+	uint8_t saved_cgram[CGRAM_SIZE];
+	std::bitset<DDRAM_SIZE> saved_ddram_known = this->ddram_known;
+	std::bitset<CGRAM_SIZE> saved_cgram_known = this->cgram_known;
+	memcpy(saved_ddram, this->ddram, sizeof(saved_ddram));
+	memcpy(saved_cgram, this->cgram, sizeof(saved_cgram));
+
+	uint8_t saved_control = this->display_control;
+	uint8_t saved_mode = this->display_mode;
+	uint8_t saved_backlight = this->backlight_flag;
+	bool saved_cgram_ac = this->ac_cgram;
+	uint8_t saved_ac = this->address_counter;
+	uint8_t saved_row = this->current_row;
+	uint8_t saved_col = this->current_col;
+
+	// RU symbols table is kept: CGRAM is restored below
+	this->init_controller();
+
+	for(uint8_t addr = 0; addr < CGRAM_SIZE; ++addr){
+		if(saved_cgram_known.test(addr)){
+			this->set_address(true, addr);
+			this->send_data(saved_cgram[addr]);
+		}
+	}
+
+	for(uint8_t addr = 0; addr < DDRAM_SIZE; ++addr){
+		if(saved_ddram_known.test(addr) && (saved_ddram[addr] != ' ')){
+			this->set_address(false, addr);
+			this->send_data(saved_ddram[addr]);
+		}
+	}
+
+	this->backlight_flag = saved_backlight;
+	this->display_control = saved_control;
+	this->send_command(LCD_DISPLAYCONTROL | this->display_control);
+	this->display_mode = saved_mode;
+	this->send_command(LCD_ENTRYMODESET | this->display_mode);
+	this->set_address(saved_cgram_ac, saved_ac);
+	this->current_row = saved_row;
+	this->current_col = saved_col;
+}
+
+// --- Timings calibration ---
+
+bool LCD1602::load_timings(const std::string &path, timings &t)
+{
+	FILE *fp = fopen(path.c_str(), "r");
+	if( !fp ){
+		return false;
+	}
+
+	timings res;
+	char key[32];
+	unsigned long value = 0;
+	int fields = 0;
+
+	while(fscanf(fp, " %31[^=]=%lu", key, &value) == 2){
+		if( !strcmp(key, "command") ){
+			res.command = value;
+		}
+		else if( !strcmp(key, "clear") ){
+			res.clear = value;
+		}
+		else if( !strcmp(key, "init_long") ){
+			res.init_long = value;
+		}
+		else if( !strcmp(key, "init_short") ){
+			res.init_short = value;
+		}
+		++fields;
+	}
+
+	fclose(fp);
+
+	if(fields == 0){
+		return false;
+	}
+
+	// Profiles with too short init waits (saved by older versions of calibrate())
+	if(res.init_long < INIT_LONG_MIN_US){
+		res.init_long = INIT_LONG_MIN_US;
+	}
+	if(res.init_short < INIT_SHORT_MIN_US){
+		res.init_short = INIT_SHORT_MIN_US;
+	}
+
+	t = res;
+	return true;
+}
+
+bool LCD1602::save_timings(const std::string &path, const timings &t)
+{
+	FILE *fp = fopen(path.c_str(), "w");
+	if( !fp ){
+		return false;
+	}
+
+	fprintf(fp, "command=%lu\nclear=%lu\ninit_long=%lu\ninit_short=%lu\n", 
+		(unsigned long)t.command, (unsigned long)t.clear, (unsigned long)t.init_long, (unsigned long)t.init_short);
+
+	return fclose(fp) == 0;
+}
+
+std::string LCD1602::timings_path(const std::string &i2c_dev, uint8_t lcd_addr)
+{
+	char addr[8];
+	snprintf(addr, sizeof(addr), "%02x", lcd_addr);
+
+	// /dev/i2c-0 -> i2c-0
+	size_t pos = i2c_dev.rfind('/');
+	std::string dev_name = (pos == std::string::npos) ? i2c_dev : i2c_dev.substr(pos + 1);
+
+	return std::string(LCD_TIMINGS_DIR) + "/" + dev_name + "-" + addr + ".conf";
+}
+
+// Writes test pattern to the first row and reads it back
+bool LCD1602::check_pattern(uint8_t seed)
+{
+	uint8_t pattern[16];
+
+	for(uint8_t i = 0; i < sizeof(pattern); ++i){
+		pattern[i] = 'A' + ((seed + i * 7) % 26);
+	}
+
+	this->set_address(false, 0, true);
+	for(uint8_t i = 0; i < sizeof(pattern); ++i){
+		this->send_data(pattern[i]);
+	}
+
+	this->set_address(false, 0, true);
+	for(uint8_t i = 0; i < sizeof(pattern); ++i){
+		if(this->read_data() != pattern[i]){
+			return false;
+		}
+	}
+
+	return true;
+}
+
+LCD1602::timings LCD1602::calibrate(unsigned trials, unsigned margin_pct)
+{
+	TRACE_SPAN("LCD1602::calibrate", "lcd");
+
+	// Without checks every candidate passes
+	if(trials < 1){
+		throw std::runtime_error("calibrate: at least one trial is needed");
+	}
+
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	const timings safe;
+	timings best = safe;
+
+	// Checks candidate timings with write-then-readback. Controller is resynchronized 
+	// with safe timings after failure, because garbled nibbles could break 4-bit mode.
+	auto check = [this, trials, &safe](const timings &t, bool reinit) -> bool {
+		this->delays = t;
+		bool ok = true;
+
+		try{
+			if(reinit){
+				this->init_controller();
+			}
+
+			for(unsigned i = 0; ok && (i < trials); ++i){
+				ok = this->check_pattern(i);
+			}
+		}
+		catch(const std::runtime_error &){
+			ok = false;
+		}
+
+		if( !ok ){
+			this->delays = safe;
+			this->init_controller();
+		}
+
+		return ok;
+	};
+
+	// Binary search of the minimal passing value
+	auto search = [&best, &check](uint32_t timings::*field, bool reinit) {
+		uint32_t lo = 0;
+		uint32_t hi = best.*field;
+
+		while(lo < hi){
+			uint32_t mid = (lo + hi) / 2;
+			timings t = best;
+			t.*field = mid;
+
+			if(check(t, reinit)){
+				hi = mid;
+			}
+			else{
+				lo = mid + 1;
+			}
+		}
+
+		best.*field = hi;
+	};
+
+	this->delays = safe;
+	this->init_controller();
+
+	// Clear / return home: measure execution time with busy flag
+	uint32_t clear_us = 0;
+	for(unsigned i = 0; i < trials * 2; ++i){
+		// Execution starts at the end of the transfer
+		this->send_4bit((i % 2) ? LCD_RETURNHOME : LCD_CLEARDISPLAY, 0);
+		auto start = std::chrono::steady_clock::now();
+
+		while(this->read_busy_address() & BUSY_FLAG){
+			if(std::chrono::steady_clock::now() - start > std::chrono::microseconds(safe.clear * 10)){
+				throw std::runtime_error("calibrate: controller stays busy");
+			}
+		}
+
+		uint32_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		if(us > clear_us){
+			clear_us = us;
+		}
+	}
+	best.clear = (clear_us < safe.clear) ? clear_us : safe.clear;
+	this->clear();
+
+	// Commands and data transfers. Initialization waits keep their safe values: a running
+	// controller accepts function sets at any speed, only power-up needs these waits.
+	search(&timings::command, false);
+
+	// Safety margin (at least 1us)
+	uint32_t timings::*fields[] = { &timings::command, &timings::clear };
+	for(auto field : fields){
+		best.*field += (best.*field * margin_pct) / 100 + 1;
+		if(best.*field > safe.*field){
+			best.*field = safe.*field;
+		}
+	}
+
+	this->delays = best;
+	this->init_controller();
+
+	return best;
+}
+
 // --- Russian language support --- 
 
 // Clear current software symbols indexes
@@ -343,19 +1458,30 @@ void LCD1602::reset_ru_symb_table()
 {
 	this->current_symb_idx = 0;
 
-	for(auto &kv : ru_symb_table){
-		kv.second.bitmap_idx = B_NOIDX;
+	for(auto &wc : this->ru_symb_locations){
+		wc = 0;
 	}
 }
 
 // Prints existing or creates in CGDRAM than prints new Cyrrilic character
-void LCD1602::print_ru_char(const uint8_t *charmap, uint8_t *index)
+void LCD1602::print_ru_char(wchar_t wc, const uint8_t *charmap)
 {
+	TRACE_SPAN("LCD1602::print_ru_char", "lcd");
+
+	// Locations reserved for external renderers are not used for RU symbols
+	uint8_t max_idx = B_LOCATIONS - this->user_chars_reserved;
+	if(max_idx > B_MAXIDX){
+		max_idx = B_MAXIDX;
+	}
+
 	// Print existing symbol
-	if(*index != B_NOIDX){
-		this->user_char_print(*index);
-		return;
+	for(uint8_t idx = 0; idx < max_idx; ++idx){
+		if(this->ru_symb_locations[idx] == wc){
+			this->user_char_print(idx);
+			return;
+		}
 	}
+
   	// Create new symbol. After CGDRAM update, cursor pisiton is reset - saving current position.
 	uint8_t row = get_current_row();
 	uint8_t col = get_current_col();
@@ -364,92 +1490,40 @@ void LCD1602::print_ru_char(const uint8_t *charmap, uint8_t *index)
 	this->set_cursor(row, col);
 	this->user_char_print(this->current_symb_idx);
 
-	// Save created character's index, and increment sign-generator index
-	*index = this->current_symb_idx++;
+	// Save created character's location, and increment sign-generator index
+	this->ru_symb_locations[this->current_symb_idx++] = wc;
 
-	if(this->current_symb_idx >= B_MAXIDX){
+	if(this->current_symb_idx >= max_idx){
 		this->reset_ru_symb_table();
 	}
 }
 
-// Mixed print - supports both ENG and RU symbols
-// Scans wc to choose correct print method and add new RU symbol if neede
+// Mixed print - converts wc with the display charset:
+// ROM symbol, software generated symbol (CGRAM), transliteration or '?'
 void LCD1602::print_wc(wchar_t wc) 
 {
-	// RU-letters that are equal to ENG symbols
-	switch(wc){
-		// А
-		case 1040: this->print("A"); break;
-		// В
-		case 1042: this->print("B"); break;
-		// Е
-		// Ё
-		case 1045: 
-		case 1025: this->print("E"); break;
-		// К
-		case 1050: this->print("K"); break;
-		// M
-		case 1052: this->print("M"); break;
-		// H
-		case 1053: this->print("H"); break;
-		// O
-    	case 1054: this->print("O"); break;
-    	// P
-		case 1056: this->print("P"); break;
-		// C
-		case 1057: this->print("C"); break;
-		// T
-		case 1058: this->print("T"); break;
-		// X 
-		case 1061: this->print("X"); break;
-		// а
-		case 1072: this->print("a"); break;
-		// е
-		case 1077: this->print("e"); break;
-		// o
-		case 1086: this->print("o"); break;
-		// p 
-		case 1088: this->print("p"); break;
-		// c
-		case 1089: this->print("c"); break;
-		// y
-		case 1091: this->print("y"); break;
-		// x
-		case 1093: this->print("x"); break;
-		// Знак градуса
-		case 0x00B0: this->user_char_print(223); break;
+	hw::bus_lock lck(this->address, this->bus_locking());
 
-		default:
-		{
-			// Check if symbol is RU
-			auto it = ru_symb_table.find(wc);
+	uint16_t entry = this->charset->lookup(static_cast<uint32_t>(wc));
+	uint16_t value = LCDCharset::value_of(entry);
 
-			if(it != ru_symb_table.end()){
-				this->print_ru_char(it->second.bitmap, &it->second.bitmap_idx);
-				break;
-			}
+	switch(LCDCharset::kind_of(entry)){
+		case LCDCharset::ROM:
+			this->user_char_print(static_cast<uint8_t>(value));
+			break;
 
-			// Else symbol is ENG - just print
-			this->print_char(static_cast<char>(wc));
-		}
-	}
-}
+		case LCDCharset::GLYPH:
+			this->print_ru_char(wc, this->charset->glyph(value));
+			break;
 
-// Multibyte character to widechar convertion
-// returns number of bytes
-static size_t mbtowc(const char *in, wchar_t *out, uint8_t mb_num) 
-{
-	if(mb_num != 2){
-		return 0;
-	} 
+		case LCDCharset::TRANSLIT:
+			for(const char *codes = this->charset->translit(value); *codes; ++codes){
+				this->user_char_print(static_cast<uint8_t>(*codes));
+			}
+			break;
 
-	if( (in[0] & 0xC0) == 0xC0 && (in[1] & 0x80) == 0x80 ) {
-		*out = ((in[0] & 0x1F) << 6) + (in[1] & 0x3F);
- 		return 2;
-	}
-    else {
-		*out = in[0];
-		return 1;
+		default:
+			this->user_char_print(SYMB_UNKNOWN);
 	}
 }
 
@@ -475,19 +1549,80 @@ inline void LCD1602::align(size_t str_len, Alignment align_type)
 	}
 }
 
-// ENG string print
+// Next symbol of print() text. Valid UTF-8 sequences are returned as code points (true),
+// other bytes as raw character codes (false), so ROM codes like "\xDF" are printed as is.
+static bool next_symbol(const char *&str, uint32_t &code)
+{
+	const char *start = str;
+	code = LCDCharset::utf8_decode(str);
+
+	return (str - start) > 1;
+}
+
+// Display cells of the code point (transliterations take several cells)
+size_t LCD1602::symbol_width(uint32_t cp) const
+{
+	uint16_t entry = this->charset->lookup(cp);
+
+	if(LCDCharset::kind_of(entry) == LCDCharset::TRANSLIT){
+		return strlen(this->charset->translit(LCDCharset::value_of(entry)));
+	}
+
+	return 1;
+}
+
+// Prints symbols of str while they fit into max_cells. Returns cells taken.
+size_t LCD1602::print_cells(const char *str, size_t max_cells)
+{
+	size_t cells = 0;
+	uint32_t code;
+
+	while(*str){
+		const char *next = str;
+		bool utf8 = next_symbol(next, code);
+		size_t width = utf8 ? this->symbol_width(code) : 1;
+
+		if(cells + width > max_cells){
+			break;
+		}
+
+		if(utf8){
+			this->print_wc(static_cast<wchar_t>(code));
+		}
+		else{
+			this->print_char(static_cast<char>(code));
+		}
+
+		cells += width;
+		str = next;
+	}
+
+	return cells;
+}
+
+// ENG string print. UTF-8 symbols are converted by the display charset.
 void LCD1602::print_str(const char *str, Alignment align_type) 
 {
-	align(strlen(str), align_type);
+	TRACE_SPAN("LCD1602::print_str", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
+	size_t width = 0;
+	uint32_t code;
 
-	while(*str) {
-		this->print_char(*str);
-		++str;
+	for(const char *ptr = str; *ptr; ){
+		width += next_symbol(ptr, code) ? this->symbol_width(code) : 1;
 	}
+
+	align(width, align_type);
+
+	this->print_cells(str, width);
 }
 
 void LCD1602::print(const char *fmt, ...)
 {
+	TRACE_SPAN("LCD1602::print", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
+
 	char str[128] = {0};
 
 	va_list args;
@@ -504,15 +1639,22 @@ void LCD1602::print(const char *fmt, ...)
 	va_end(args);
 }
 
+// Text is cut at the end of the row, so it never runs into invisible DDRAM cells
 void LCD1602::print_with_padding(const std::string &str, char symb)
 {	
-	this->print_str(str.c_str(), Alignment::NO);
+	TRACE_SPAN("LCD1602::print_with_padding", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
 
-	int indent_len = this->get_num_cols() - this->get_current_col();
+	int room = this->get_num_cols() - this->get_current_col();
+	if(room <= 0){
+		return;
+	}
+
+	int indent_len = room - this->print_cells(str.c_str(), room);
 
 	if(indent_len > 0){
 		std::string padding(indent_len, symb);
-		this->print_str(padding.c_str(), Alignment::NO);
+		this->print_cells(padding.c_str(), indent_len);
 	}
 }
 
@@ -520,143 +1662,40 @@ void LCD1602::print_with_padding(const std::string &str, char symb)
 // Cyrrilic symbols are software generated. Max 8 RU-letters on the screen at one time.
 void LCD1602::print_ru(const char *str) 
 {
-	wchar_t wstr;
-	size_t shift = 0;
-	size_t size = std::strlen(str);
+	TRACE_SPAN("LCD1602::print_ru", "lcd");
+	hw::bus_lock lck(this->address, this->bus_locking());
 
-	while(shift < size){
-		shift += mbtowc(str + shift, &wstr, 2);
-		this->print_wc(wstr);
+	while(*str){
+		this->print_wc(static_cast<wchar_t>(LCDCharset::utf8_decode(str)));
 	}
 }
 
+size_t LCD1602::text_width(const char *str) const
+{
+	size_t width = 0;
 
-// --- WH1602B_CTK implementation ---
+	while(*str){
+		width += this->symbol_width(LCDCharset::utf8_decode(str));
+	}
 
-// RU-symbol unicode -> ROM memory address.
-const std::unordered_map<wchar_t, uint8_t> WH1602B_CTK::symb_codes = {
-	{1025, 162}, // Ё
-	{1041, 160}, // Б
-	{1043, 161}, // Г
-	{1044, 224}, // Д
-	{1046, 163}, // Ж 
-	{1047, 164}, // З
-	{1048, 165}, // И
-	{1049, 166}, // Й
-	{1051, 167}, // Л
-	{1055, 168}, // П
-	{1059, 169}, // У
-	{1060, 170}, // Ф
-	{1062, 225}, // Ц
-	{1063, 171}, // Ч
-	{1064, 172}, // Ш
-	{1065, 226}, // Щ
-	{1066, 173}, // Ъ
-	{1067, 174}, // Ы
-	{1069, 175}, // Э
-	{1070, 176}, // Ю
-	{1071, 177}, // Я
-	{1073, 178}, // б
-	{1074, 179}, // в
-	{1075, 180}, // г
-	{1076, 227}, // д
-	{1105, 181}, // ё
-	{1078, 182}, // ж
-	{1079, 183}, // з
-	{1080, 184}, // и
-	{1081, 185}, // й
-	{1082, 186}, // к
-	{1083, 187}, // л
-	{1084, 188}, // м
-	{1085, 189}, // н
-	{1087, 190}, // п
-	{1090, 191}, // т
-	{1092, 228}, // ф
-	{1094, 229}, // ц
-	{1095, 192}, // ч
-	{1096, 193}, // ш
-	{1097, 230}, // щ
-	{1098, 194}, // ъ
-	{1099, 195}, // ы
-	{1100, 196}, // ь
-	{1101, 197}, // э
-	{1102, 198}, // ю
-	{1103, 199}, // я
-};
-
-// Mixed print. Uses ROM symbols table.
-void WH1602B_CTK::print_wc(wchar_t wc) 
-{
-	// RU-letters that are equal to ENG symbols
-	switch(wc){
-		// А
-		case 1040: this->user_char_print('A'); break;
-		// В
-		case 1042: this->user_char_print('B'); break;
-		// Е
-		case 1045: this->user_char_print('E'); break;
-		// К
-		case 1050: this->user_char_print('K'); break;
-		// M
-		case 1052: this->user_char_print('M'); break;
-		// H
-		case 1053: this->user_char_print('H'); break;
-		// O
-    	case 1054: this->user_char_print('O'); break;
-    	// P
-		case 1056: this->user_char_print('P'); break;
-		// C
-		case 1057: this->user_char_print('C'); break;
-		// T
-		case 1058: this->user_char_print('T'); break;
-		// X 
-		case 1061: this->user_char_print('X'); break;
-		// Ь
-		case 1068: this->user_char_print('b'); break;
-		// а
-		case 1072: this->user_char_print('a'); break;
-		// е
-		case 1077: this->user_char_print('e'); break;
-		// o
-		case 1086: this->user_char_print('o'); break;
-		// p 
-		case 1088: this->user_char_print('p'); break;
-		// c
-		case 1089: this->user_char_print('c'); break;
-		// y
-		case 1091: this->user_char_print('y'); break;
-		// x
-		case 1093: this->user_char_print('x'); break;
-		// Знак градуса
-		case 0x00B0: this->user_char_print(223); break;
+	return width;
+}
 
-		default:
-		{
-			auto it = symb_codes.find(wc);
 
-			if(it != symb_codes.end()){
-				this->user_char_print(it->second);
-				break;
-			}
-
-			// ENG symbols are at the same addresses as their ASCII codes
-			this->user_char_print(static_cast<const char>(wc));
-		}
-	}
-}
+// --- WH1602B_CTK implementation ---
 
 void WH1602B_CTK::print_str(const char *str, Alignment align_type)
 {
-	wchar_t wstr = 0;
-	size_t shift = 0;
+	TRACE_SPAN("WH1602B_CTK::print_str", "lcd");
+
 	size_t bytes_num = 0;
-	size_t symbols_num = number_of_symbols(str, &bytes_num);
+	number_of_symbols(str, &bytes_num);
+	const char *end = str + bytes_num;
 
-	LCD1602::align(symbols_num, align_type);
+	LCD1602::align(this->text_width(str), align_type);
 
-	while(shift < bytes_num){
-		shift += mbtowc(str + shift, &wstr, 2);
-		this->print_wc(wstr);
+	while(str < end){
+		this->print_ru(static_cast<wchar_t>(LCDCharset::utf8_decode(str)));
 	}
 }
 
@@ -5,6 +5,7 @@
 // -- Features:
 // 1. ENG and RU symbols printing support
 // 2. Additional class WH1602B_CTK for Cyrillic LCD implementation
+// 3. Character ROM variants (A00, A02, WH1602B) with transliteration fallbacks (LCDCharset)
 //
 // -- LCD Connection:
 // The LCD controller is wired to the I2C port expander with the upper 4 bits
@@ -22,8 +23,12 @@
 
 #include <cstdint>
 #include <string>
-#include <unordered_map>
 #include <tuple>
+#include <bitset>
+#include <vector>
+#include <ctime>
+
+#include "lcd_charset.hpp"
 
 // Supported i2c-adapters chip addresses 
 #define PCF8574A_ADDR   		0x7E
@@ -46,20 +51,116 @@ public:
 		CENTER,
 	};
 
+	// Controller delays in microseconds (datasheet worst cases by default)
+	struct timings
+	{
+		uint32_t command = 50;		// after each command / data transfer (> 37us)
+		uint32_t clear = 2000;		// after clear() and return_home() (> 1.52ms)
+		uint32_t init_long = 4500;	// after the 1st 8-bit function set (> 4.1ms)
+		uint32_t init_short = 150;	// after the 2nd 8-bit function set (> 100us)
+	};
+
 	// User character data
 	typedef struct {
-		uint8_t bitmap_idx;
+		uint8_t bitmap_idx;			// not used (locations are tracked per display)
 		uint8_t bitmap[8];
 	}custom_char;
 
 	LCD1602(uint8_t lcd_addr = PCF8574A_ADDR): address(lcd_addr){}
 
-	virtual ~LCD1602() = default;
+	// Waits for the last command completion, so the next user of the display can't break it
+	virtual ~LCD1602();
 
-	// Initialization method must be called before any other
+	// Initialization method must be called before any other.
+	// Timings profile is loaded from timings_path() if it exists.
 	void init(uint8_t lcd_addr, const std::string &i2c_dev = "");
 	void set_addr(uint8_t lcd_addr) { address = lcd_addr; }
 
+	// Non-blocking initialization: init_begin() is followed by init_step() calls until it
+	// returns true. init_step() sends the steps which are due and returns without waiting,
+	// get_ready_deadline() is the time of the next step (CLOCK_MONOTONIC).
+	// Lets a scheduler interleave init sequences of many displays.
+	void init_begin(uint8_t lcd_addr, const std::string &i2c_dev = "");
+	bool init_step();
+	const struct timespec& get_ready_deadline() const { return ready_at; }
+	// Initializes displays (at their get_addr()) with interleaved init sequences.
+	// Failed displays don't stop the others. Returns error message per display
+	// (empty - initialized).
+	static std::vector<std::string> init_all(const std::vector<LCD1602*> &lcds);
+
+	// Copy controller state model from src, that has sent the same traffic to its display
+	// (e.g. member of a mirror group). Own address is kept.
+	void copy_state(const LCD1602 &src);
+
+	// Driver state snapshot (plain data, so it can be kept in a file or shared memory):
+	// controller state model, cursor, software symbols in CGRAM and timings.
+	// Lets short-lived processes continue where the previous one stopped.
+	struct saved_state
+	{
+		uint32_t version;
+		uint8_t backlight_flag;
+		uint8_t display_function;
+		uint8_t display_control;
+		uint8_t display_mode;
+		uint8_t state_known;
+		uint8_t ac_cgram;
+		uint8_t address_counter;
+		uint8_t current_row;
+		uint8_t current_col;
+		uint8_t current_symb_idx;
+		uint8_t ddram[0x80];
+		uint8_t cgram[0x40];
+		uint8_t ddram_known[0x80 / 8];
+		uint8_t cgram_known[0x40 / 8];
+		uint32_t ru_symb_locations[8];
+		timings delays;
+	};
+	void save_state(saved_state &st) const;
+	// Returns false (state is not changed) if the snapshot is from another driver version
+	bool restore_state(const saved_state &st);
+
+	// Forget controller state model, so next commands are sent unconditionally
+	// (e.g. when display was reinitialized or changed by someone else)
+	void invalidate_state() { state_known = false; }
+
+	// Readback verification (R/W pin of the controller must be wired to PCF8574 P1).
+	// Compares up to max_cells DDRAM / CGRAM cells with the driver's model and rewrites
+	// mismatching ones. Reinitializes the controller if it stops responding.
+	// If the controller is busy right after reinit too, R/W is considered not wired and
+	// verification is disabled until init(). Returns number of repaired cells.
+	size_t verify_step(size_t max_cells);
+	bool has_readback() const { return readback; }
+	// Reinitialize the controller and repaint DDRAM / CGRAM contents from the model
+	void recover();
+	// Busy flag (bit 7) and address counter (bits 0-6)
+	uint8_t read_busy_address();
+
+	// Timings profile
+	void set_timings(const timings &t) { delays = t; }
+	const timings& get_timings() const { return delays; }
+	static bool load_timings(const std::string &path, timings &t);
+	static bool save_timings(const std::string &path, const timings &t);
+	// Default profile location for the display: LCD_TIMINGS_DIR/<i2c-dev>-<addr>.conf
+	static std::string timings_path(const std::string &i2c_dev, uint8_t lcd_addr);
+
+	// Finds the shortest reliable command and clear delays for this display (using busy flag
+	// and write-then-readback checks) and sets them with margin_pct safety margin. Init waits
+	// keep their safe values. Display is cleared. Readback support is required, trials >= 1.
+	timings calibrate(unsigned trials = 3, unsigned margin_pct = 25);
+
+	// Frame transaction: DDRAM / CGRAM writes (print, set_cursor, clear, user_char_create)
+	// are staged until commit_frame(), so the frame appears at once. Commit uploads changed
+	// CGRAM locations first, then changed DDRAM cells in minimal runs. With blank = true
+	// the display is turned off while the most of the screen is rewritten.
+	// Other commands (control, scroll, entry mode, return_home) are applied immediately.
+	// With hw::i2c_set_locking(true) the bus lock is held from begin_frame() to commit_frame()
+	// (other operations take it for their own duration), so the thread must be the same.
+	void begin_frame();
+	void commit_frame(bool blank = false);
+	// Drops staged changes
+	void abort_frame();
+	bool in_frame() const { return frame_active; }
+
 	// Configure methods
 	void clear();
 	void control(bool backlight, bool cursor = false, bool blink = false);
@@ -91,21 +192,60 @@ public:
 		this->print_str(str.c_str(), align); 
 	}
 
-	// Adds padding after str to fit row length (cols num. 
+	// Adds padding after str to fit row length (cols num), str is cut at the row end.
+	// Text is measured in display cells.
 	// Note: can be used with spaces symbols to avoid clear() calls.
 	virtual void print_with_padding(const std::string &str, char symb = ' ');
 
-	// ENG + RU string support 
-	// Cyrrilic symbols are software generated. Max 8 RU-letters on the screen at one time.
+	// UTF-8 string support (ENG, RU and other symbols of the display charset).
+	// Symbols missing in the ROM are software generated. Max 8 of them on the screen at one time.
 	void print_ru(const wchar_t wc) { this->print_wc(wc); }
 	void print_ru(const char *str);
 	void print_ru(const std::string &str) { this->print_ru(str.c_str()); }
+	// Width of UTF-8 text / one code point in display cells (transliterated symbols take
+	// several cells)
+	size_t text_width(const char *str) const;
+	size_t symbol_width(uint32_t cp) const;
 
 	// User-defined charecters methods (location: 0-7)
 	void user_char_create(uint8_t location, const uint8_t *charmap);
 	void user_char_print(uint8_t location);
+	// Raw character codes (ROM symbols, CGRAM locations) at the cursor, sent as one run
+	void print_codes(const uint8_t *codes, size_t len);
 	inline void align(size_t len, Alignment align_type);
 
+	// Character ROM of the display (A00 by default). Set it before init().
+	void set_charset(LCDCharset::Rom rom) { charset = &LCDCharset::get(rom); }
+	LCDCharset::Rom get_charset() const { return charset->get_rom(); }
+
+	// Reserve user-defined characters locations for the application's own characters.
+	// Locations are taken from the top (7, 6, ...), software Cyrillic symbols use the rest.
+	// Returns first reserved location. Max 7 locations can be reserved (count = 0 - release).
+	// Must be called before renderers acquire their locations.
+	uint8_t reserve_user_chars(uint8_t count);
+	// Number of top locations not available for software Cyrillic symbols
+	uint8_t get_reserved_user_chars() const { return user_chars_reserved; }
+
+	// Locations of external renderers (e.g. LCDGraphics): up to count free locations as one
+	// block, the highest free ones first. Returns number of taken locations (0 - none are
+	// free), first is the lowest location of the block. Blocks are owned by the renderers
+	// and may be released in any order.
+	uint8_t acquire_user_chars(uint8_t count, uint8_t &first);
+	void release_user_chars(uint8_t first, uint8_t count);
+
+protected:
+	// Sends expander bytes run (one transaction)
+	virtual void write_expander(const uint8_t *buf, uint16_t len);
+
+	// Controller is busy for exec_us after the last transfer. Next transfer waits
+	// for this deadline, so bus transfer time is not added to the delays.
+	virtual void set_ready_deadline(uint32_t exec_us);
+	virtual void wait_ready_deadline();
+
+	// Operations take the cross-process bus lock (hw::bus_lock). Drivers, that don't
+	// access the bus themselves, lock it where their transfers are done.
+	virtual bool bus_locking() const { return true; }
+
 private:
 	uint8_t address = 0;					// i2c port expander chip address
 	uint8_t num_rows = 2;					// number of screen lines
@@ -115,6 +255,51 @@ private:
 	uint8_t display_function = 0;			// function set status
 	uint8_t display_control = 0;			// control status (backlight, cursor, blink)
 	uint8_t display_mode = 0;				// mode set status
+	timings delays;
+
+	// Time (CLOCK_MONOTONIC), when controller finishes the last command
+	struct timespec ready_at = {0, 0};
+	int8_t init_stage = -1;					// next initialization step (-1 - not running)
+
+	// Controller state model. Commands that don't change the state are not sent
+	// to the bus while the model is known (after init()).
+	bool state_known = false;
+	bool ac_cgram = false;					// address counter points to CGRAM (DDRAM otherwise)
+	uint8_t address_counter = 0;			// current DDRAM / CGRAM address
+	void advance_address_counter();
+	void set_address(bool cgram, uint8_t addr, bool force = false);
+
+	// DDRAM / CGRAM contents model (valid while state is known)
+	uint8_t ddram[0x80];
+	uint8_t cgram[0x40];
+	std::bitset<0x80> ddram_known;
+	std::bitset<0x40> cgram_known;
+	size_t verify_pos = 0;					// next cell for verify_step()
+	bool readback = true;					// R/W is wired: reads are possible
+
+	// Staged frame (begin_frame() .. commit_frame()). Address counter model follows
+	// staged writes, controller's one is saved in frame_bus_*.
+	bool frame_active = false;
+	bool frame_locked = false;				// bus lock is held for the frame (hw::i2c_lock)
+	bool frame_bus_cgram = false;
+	uint8_t frame_bus_ac = 0;
+	uint8_t frame_row = 0;					// cursor position at begin_frame()
+	uint8_t frame_col = 0;
+	uint8_t frame_ddram[0x80];
+	uint8_t frame_cgram[0x40];
+	std::bitset<0x80> frame_ddram_staged;
+	std::bitset<0x40> frame_cgram_staged;
+	uint8_t frame_symb_idx = 0;				// RU symbols table at begin_frame() (uploads are staged)
+	wchar_t frame_ru_symb_locations[8] = {0};
+
+	struct frame_cell
+	{
+		uint8_t addr;
+		int16_t value;			// data to write (-1 - unknown, can't be written through)
+		bool dirty;
+	};
+	void write_cells(bool cgram, const frame_cell *cells, size_t num);
+	void frame_unlock();
 
 	// Cursor position
 	uint8_t current_row = 0;
@@ -125,16 +310,30 @@ private:
 	void send_4bit(uint8_t data, uint8_t flags);
 	void send_command(uint8_t cmd) { this->send_4bit(cmd, 0); }
 	void send_data(uint8_t data);
+	void send_data_run(const uint8_t *data, size_t len);
+	uint8_t read_4bit(uint8_t flags);
+	uint8_t read_data();
+	bool wait_ready();
+	void init_controller();
+	void init_reset();
+	bool init_next();
+	bool check_pattern(uint8_t seed);
 
 	// RU characters support with CGRAM implementation methods
 	uint8_t current_symb_idx = 0;
-	static std::unordered_map<wchar_t, custom_char> ru_symb_table;	// symbol unicode -> bitmap
+	uint8_t user_chars_reserved = 0;	// number of CGRAM locations not available for RU symbols
+	uint8_t user_chars_app = 0;			// locations mask: reserve_user_chars()
+	uint8_t user_chars_owned = 0;		// locations mask: acquire_user_chars()
+	void update_user_chars();
+	const LCDCharset *charset = &LCDCharset::get(LCDCharset::Rom::A00);
+	wchar_t ru_symb_locations[8] = {0};		// symbol unicode stored at CGRAM location (0 - none)
 	void reset_ru_symb_table();
-	void print_ru_char(const uint8_t *charmap, uint8_t *index);
+	void print_ru_char(wchar_t wc, const uint8_t *charmap);
 
 	// Mixed print - supports both ENG and RU symbols
 	virtual void print_wc(wchar_t wc);
 	virtual void print_str(const char *str, Alignment align_type);
+	size_t print_cells(const char *str, size_t max_cells);
 };
 
 
@@ -144,20 +343,17 @@ private:
 class WH1602B_CTK final: public LCD1602
 {
 public:
-	WH1602B_CTK(uint8_t lcd_addr = PCF8574A_ADDR): LCD1602(lcd_addr) {}
+	WH1602B_CTK(uint8_t lcd_addr = PCF8574A_ADDR): LCD1602(lcd_addr) { this->set_charset(LCDCharset::Rom::WH1602B); }
 
 	// Print ENG + RU strings (Hardware supports Cyrillic symbols)
 	// void print(const char *fmt, ...);
 	// void print(const std::string &str);
 
-	void print_char(char ch) override { this->print_wc(static_cast<wchar_t>(ch)); }
+	void print_char(char ch) override { this->print_ru(static_cast<wchar_t>(static_cast<uint8_t>(ch))); }
 
 private:
-	static const std::unordered_map<wchar_t, uint8_t> symb_codes;
-
-	// print() functions uses print_wc() and print_str() as backend,
-	// so only these two methods should be overrided
-	void print_wc(wchar_t wc) override;
+	// print() functions uses print_wc() and print_str() as backend.
+	// Symbols are converted by the display charset, so only print_str() is overrided.
 	void print_str(const char *str, Alignment align_type) override;
 };
 
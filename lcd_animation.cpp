@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "lcd_animation.hpp"
+#include "trace.hpp"
+
+// Controller transfers of a full bitmap upload (address + 8 rows)
+#define FULL_UPLOAD_COST 		9
+
+LCDAnimator::LCDAnimator(LCD1602 &lcd, uint8_t slots): lcd(lcd)
+{
+	this->animations.resize(lcd.acquire_user_chars(slots, this->first_slot));
+}
+
+LCDAnimator::~LCDAnimator()
+{
+	lcd.release_user_chars(this->first_slot, this->animations.size());
+}
+
+void LCDAnimator::start(uint8_t slot, const std::vector<bitmap> &frames, unsigned period_ms)
+{
+	if(slot >= this->animations.size() || frames.empty() || period_ms == 0){
+		throw std::runtime_error("LCDAnimator: invalid animation parameters");
+	}
+
+	animation &a = this->animations[slot];
+	a.frames = frames;
+	a.period = std::chrono::milliseconds(period_ms);
+	a.started = clock::now();
+	a.running = true;
+	a.frame = 0;
+}
+
+void LCDAnimator::stop(uint8_t slot)
+{
+	if(slot < this->animations.size()){
+		this->animations[slot].running = false;
+	}
+}
+
+void LCDAnimator::place(uint8_t slot, uint8_t row, uint8_t col)
+{
+	uint8_t cur_row = this->lcd.get_current_row();
+	uint8_t cur_col = this->lcd.get_current_col();
+
+	this->lcd.set_cursor(row, col);
+	this->lcd.user_char_print(this->first_slot + slot);
+	this->lcd.set_cursor(cur_row, cur_col);
+}
+
+void LCDAnimator::invalidate()
+{
+	for(animation &a : this->animations){
+		a.uploaded = false;
+	}
+}
+
+size_t LCDAnimator::due_frame(const animation &a, clock::time_point now) const
+{
+	return static_cast<size_t>((now - a.started) / a.period) % a.frames.size();
+}
+
+// Same rows grouping as LCD1602::user_char_create(): one address setting per run,
+// single unchanged rows inside a run are written through
+unsigned LCDAnimator::upload_cost(const animation &a, const bitmap &bm) const
+{
+	if( !a.uploaded ){
+		return FULL_UPLOAD_COST;
+	}
+
+	unsigned cost = 0;
+	int last = -3;
+
+	for(int row = 0; row < 8; ++row){
+		if(a.shown[row] == bm[row]){
+			continue;
+		}
+
+		cost += (row - last <= 2) ? (row - last) : 2;
+		last = row;
+	}
+
+	return cost;
+}
+
+LCDAnimator::clock::duration LCDAnimator::tick(unsigned max_transfers)
+{
+	TRACE_SPAN("LCDAnimator::tick", "lcd");
+
+	clock::time_point now = clock::now();
+	std::vector<size_t> due;
+	std::vector<clock::time_point> due_since(this->animations.size());
+
+	for(size_t i = 0; i < this->animations.size(); ++i){
+		const animation &a = this->animations[i];
+
+		if( !a.running ){
+			continue;
+		}
+
+		size_t frame = this->due_frame(a, now);
+		if(a.uploaded && frame == a.frame){
+			continue;
+		}
+
+		// Never uploaded animations are the most overdue
+		auto periods = (now - a.started) / a.period;
+		due_since[i] = a.uploaded ? (a.started + periods * a.period) : clock::time_point::min();
+		due.push_back(i);
+	}
+
+	std::sort(due.begin(), due.end(), [&](size_t a, size_t b){
+		return due_since[a] < due_since[b];
+	});
+
+	uint8_t row = this->lcd.get_current_row();
+	uint8_t col = this->lcd.get_current_col();
+	unsigned spent = 0;
+
+	for(size_t i : due){
+		animation &a = this->animations[i];
+		size_t frame = this->due_frame(a, now);
+		const bitmap &bm = a.frames[frame];
+		unsigned cost = this->upload_cost(a, bm);
+
+		// The most overdue animation is served even if it doesn't fit alone
+		if(spent && (spent + cost > max_transfers)){
+			continue;
+		}
+
+		if(cost){
+			this->lcd.user_char_create(this->first_slot + i, bm.data());
+		}
+
+		a.shown = bm;
+		a.frame = frame;
+		a.uploaded = true;
+		spent += cost;
+	}
+
+	// Address counter points to CGRAM after uploads
+	if(spent){
+		this->lcd.set_cursor(row, col);
+	}
+
+	// Time until the next frame switch
+	clock::duration next = clock::duration::max();
+
+	for(const animation &a : this->animations){
+		if( !a.running ){
+			continue;
+		}
+
+		auto periods = (now - a.started) / a.period;
+		clock::duration left = a.started + (periods + 1) * a.period - now;
+
+		// Skipped by budget
+		if( !a.uploaded || this->due_frame(a, now) != a.frame ){
+			left = clock::duration::zero();
+		}
+
+		next = std::min(next, left);
+	}
+
+	return next;
+}
+
+const std::vector<LCDAnimator::bitmap>& LCDAnimator::spinner()
+{
+	static const std::vector<bitmap> frames = {
+		{{0b00100,0b00100,0b00100,0b00100,0b00100,0b00100,0b00100,0b00000}}, // |
+		{{0b00001,0b00010,0b00010,0b00100,0b01000,0b01000,0b10000,0b00000}}, // /
+		{{0b00000,0b00000,0b00000,0b11111,0b00000,0b00000,0b00000,0b00000}}, // -
+		{{0b10000,0b01000,0b01000,0b00100,0b00010,0b00010,0b00001,0b00000}}, // '\'
+	};
+
+	return frames;
+}
+
+// Box filling from the bottom
+const std::vector<LCDAnimator::bitmap>& LCDAnimator::activity()
+{
+	static const std::vector<bitmap> frames = {
+		{{0b11111,0b10001,0b10001,0b10001,0b10001,0b10001,0b11111,0b00000}},
+		{{0b11111,0b10001,0b10001,0b10001,0b10001,0b11111,0b11111,0b00000}},
+		{{0b11111,0b10001,0b10001,0b11111,0b11111,0b11111,0b11111,0b00000}},
+		{{0b11111,0b11111,0b11111,0b11111,0b11111,0b11111,0b11111,0b00000}},
+	};
+
+	return frames;
+}
@@ -0,0 +1,81 @@
+//
+// -- Description:
+// CGRAM animations (spinners, activity indicators) for HD44780-based LCDs
+//
+// -- Features:
+// 1. Animated cell shows a CGRAM location, frames are changed by rewriting the bitmap
+//    only: DDRAM and cursor are not touched, all cells with the glyph change together
+// 2. Only changed bitmap rows are sent (LCD1602::user_char_create() delta writes)
+// 3. Frame is chosen by time, so late ticks skip frames instead of slowing animation down
+// 4. Bus budget per tick(): the most overdue animations are served first
+//
+// tick() is meant to be called from the application's update loop (or submitted as
+// a background operation to LCDScheduler / LCDQueue), so animations share the bus
+// with other updates.
+//
+
+#ifndef _LCD_ANIMATION_HPP
+#define _LCD_ANIMATION_HPP
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <chrono>
+
+#include "lcd1602.hpp"
+
+class LCDAnimator
+{
+public:
+	typedef std::array<uint8_t, 8> bitmap;
+	typedef std::chrono::steady_clock clock;
+
+	// Reserves slots CGRAM locations (one per animation)
+	explicit LCDAnimator(LCD1602 &lcd, uint8_t slots = 1);
+	~LCDAnimator();
+
+	LCDAnimator(const LCDAnimator&) = delete;
+	LCDAnimator& operator=(const LCDAnimator&) = delete;
+
+	// Starts animation at the slot (0 .. get_slots() - 1), each frame is shown for period_ms
+	void start(uint8_t slot, const std::vector<bitmap> &frames, unsigned period_ms);
+	// Freezes animation at its current frame
+	void stop(uint8_t slot);
+
+	// Prints animated glyph of the slot at the position. Cursor position is restored.
+	void place(uint8_t slot, uint8_t row, uint8_t col);
+
+	// Uploads due frames, but not more than max_transfers controller transfers
+	// (commands and data bytes). Returns time until the next frame is due.
+	clock::duration tick(unsigned max_transfers = 16);
+
+	// Forget uploaded bitmaps (must be called after LCD1602::init())
+	void invalidate();
+
+	uint8_t get_slots() const { return static_cast<uint8_t>(animations.size()); }
+
+	// Built-in frames
+	static const std::vector<bitmap>& spinner();
+	static const std::vector<bitmap>& activity();
+
+private:
+	struct animation
+	{
+		std::vector<bitmap> frames;
+		clock::duration period;
+		clock::time_point started;
+		bool running = false;
+		bool uploaded = false;
+		bitmap shown;				// bitmap in CGRAM
+		size_t frame = 0;			// index of the shown frame
+	};
+
+	LCD1602 &lcd;
+	uint8_t first_slot = 0;
+	std::vector<animation> animations;
+
+	size_t due_frame(const animation &a, clock::time_point now) const;
+	unsigned upload_cost(const animation &a, const bitmap &bm) const;
+};
+
+#endif
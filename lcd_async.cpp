@@ -0,0 +1,301 @@
+#include <cerrno>
+#include <stdexcept>
+#include <cstring>
+
+extern "C"{
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+}
+
+#include "lcd_async.hpp"
+#include "i2c_lock.hpp"
+#include "trace.hpp"
+
+LCDLoop::LCDLoop()
+{
+	this->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(this->event_fd < 0){
+		throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+	}
+
+	this->io_thread = std::thread(&LCDLoop::io_run, this);
+}
+
+LCDLoop::~LCDLoop()
+{
+	{
+		std::lock_guard<std::mutex> lck(this->io_mutex);
+		this->io_running = false;
+		this->io_cv.notify_one();
+	}
+
+	this->io_thread.join();
+	close(this->event_fd);
+}
+
+LCDLoop::detached LCDLoop::run_task(LCDLoop *loop, LCDTask task)
+{
+	try{
+		co_await task;
+	}
+	catch(const std::exception &e){
+		++loop->errors;
+		loop->last_error = e.what();
+	}
+	catch(...){
+		++loop->errors;
+		loop->last_error = "unknown error";
+	}
+
+	--loop->active;
+}
+
+void LCDLoop::spawn(LCDTask task)
+{
+	++this->active;
+	run_task(this, std::move(task));
+}
+
+void LCDLoop::add_timer(clock::time_point tp, std::coroutine_handle<> h)
+{
+	this->timers.push(timer{tp, this->timer_seq++, h});
+}
+
+void LCDLoop::add_io(io_awaiter *awaiter, std::coroutine_handle<> h)
+{
+	std::lock_guard<std::mutex> lck(this->io_mutex);
+	this->io_jobs.push_back(io_job{awaiter, h});
+	this->io_cv.notify_one();
+}
+
+// Bus transfers are serialized by the i2c layer anyway, so one thread is enough
+void LCDLoop::io_run()
+{
+	std::unique_lock<std::mutex> lck(this->io_mutex);
+
+	for(;;){
+		this->io_cv.wait(lck, [this]{ return !this->io_running || !this->io_jobs.empty(); });
+
+		if(this->io_jobs.empty()){
+			return;
+		}
+
+		io_job job = this->io_jobs.front();
+		this->io_jobs.pop_front();
+		lck.unlock();
+
+		try{
+			job.awaiter->fn();
+		}
+		catch(...){
+			job.awaiter->error = std::current_exception();
+		}
+
+		lck.lock();
+		this->io_done.push_back(job.h);
+
+		uint64_t one = 1;
+		ssize_t res = write(this->event_fd, &one, sizeof(one));
+		(void)res;
+	}
+}
+
+bool LCDLoop::next_deadline(clock::time_point &tp) const
+{
+	if(!this->ready.empty()){
+		tp = clock::now();
+		return true;
+	}
+
+	if(this->timers.empty()){
+		return false;
+	}
+
+	tp = this->timers.top().tp;
+	return true;
+}
+
+void LCDLoop::poll()
+{
+	uint64_t cnt;
+	ssize_t res = read(this->event_fd, &cnt, sizeof(cnt));
+	(void)res;
+
+	{
+		std::lock_guard<std::mutex> lck(this->io_mutex);
+		for(auto h : this->io_done){
+			this->ready.push_back(h);
+		}
+		this->io_done.clear();
+	}
+
+	clock::time_point now = clock::now();
+	while( !this->timers.empty() && this->timers.top().tp <= now ){
+		this->ready.push_back(this->timers.top().h);
+		this->timers.pop();
+	}
+
+	// Coroutines posted while resuming wait for the next poll(), so timers and
+	// I/O completions are not starved
+	size_t num = this->ready.size();
+	while(num--){
+		std::coroutine_handle<> h = this->ready.front();
+		this->ready.pop_front();
+		h.resume();
+	}
+}
+
+void LCDLoop::run()
+{
+	while(this->active){
+		this->poll();
+
+		if( !this->active ){
+			break;
+		}
+
+		struct pollfd pfd = {this->event_fd, POLLIN, 0};
+		struct timespec ts;
+		struct timespec *timeout = nullptr;
+		clock::time_point tp;
+
+		if(this->next_deadline(tp)){
+			long long left = std::chrono::duration_cast<std::chrono::nanoseconds>(tp - clock::now()).count();
+			if(left < 0){
+				left = 0;
+			}
+			ts.tv_sec = left / 1000000000LL;
+			ts.tv_nsec = left % 1000000000LL;
+			timeout = &ts;
+		}
+
+		if(ppoll(&pfd, 1, timeout, nullptr) < 0 && errno != EINTR){
+			throw std::runtime_error(std::string("ppoll failed: ") + strerror(errno));
+		}
+	}
+}
+
+void LCDAsync::recorder::write_expander(const uint8_t *buf, uint16_t len)
+{
+	if( !this->capturing ){
+		LCD1602::write_expander(buf, len);
+		return;
+	}
+
+	this->segments.emplace_back();
+	this->segments.back().bytes.assign(buf, buf + len);
+}
+
+void LCDAsync::recorder::set_ready_deadline(uint32_t exec_us)
+{
+	if( !this->capturing ){
+		this->settle(exec_us);
+		return;
+	}
+
+	if(this->segments.empty()){
+		this->lead_us = exec_us;
+	}
+	else{
+		this->segments.back().delay_us = exec_us;
+	}
+}
+
+void LCDAsync::recorder::wait_ready_deadline()
+{
+	if( !this->capturing ){
+		LCD1602::wait_ready_deadline();
+	}
+}
+
+// Keeps both deadlines, so synchronous and async calls can follow each other
+void LCDAsync::recorder::settle(uint32_t exec_us)
+{
+	LCD1602::set_ready_deadline(exec_us);
+	this->ready_at = LCDLoop::clock::now() + std::chrono::microseconds(exec_us);
+}
+
+bool LCDAsync::lock_awaiter::await_ready()
+{
+	if(owner.busy){
+		return false;
+	}
+
+	owner.busy = true;
+	return true;
+}
+
+// Ownership is passed to the next waiter directly
+void LCDAsync::unlock()
+{
+	if(this->waiters.empty()){
+		this->busy = false;
+		return;
+	}
+
+	this->loop.post(this->waiters.front());
+	this->waiters.pop_front();
+}
+
+LCDTask LCDAsync::run(operation op)
+{
+	co_await lock_awaiter{*this};
+
+	std::exception_ptr error;
+	bool locked = false;
+
+	try{
+		std::vector<recorder::segment> segments;
+		LCDLoop::clock::time_point start = LCDLoop::clock::now();
+
+		this->lcd.capturing = true;
+		this->lcd.lead_us = 0;
+		try{
+			TRACE_SPAN("LCDAsync::encode", "lcd");
+			op(this->lcd);
+		}
+		catch(...){
+			this->lcd.capturing = false;
+			this->lcd.segments.clear();
+			throw;
+		}
+		this->lcd.capturing = false;
+		segments.swap(this->lcd.segments);
+
+		LCDLoop::clock::time_point lead = start + std::chrono::microseconds(this->lcd.lead_us);
+		if(lead > this->lcd.ready_at){
+			this->lcd.ready_at = lead;
+		}
+
+		// Lock is owned by the I/O thread, which sends the runs
+		if(hw::i2c_get_locking()){
+			co_await this->loop.run_io([this]{ hw::i2c_lock(this->lcd.get_addr()); });
+			locked = true;
+		}
+
+		for(const recorder::segment &s : segments){
+			co_await this->loop.sleep_until(this->lcd.ready_at);
+			co_await this->loop.run_io([this, &s]{ this->lcd.send(s); });
+			this->lcd.settle(s.delay_us);
+		}
+	}
+	catch(...){
+		error = std::current_exception();
+	}
+
+	if(locked){
+		co_await this->loop.run_io([this]{ hw::i2c_unlock(this->lcd.get_addr()); });
+	}
+
+	if(error){
+		// Controller state is unknown after partially applied operation
+		this->lcd.invalidate_state();
+	}
+
+	this->unlock();
+
+	if(error){
+		std::rethrow_exception(error);
+	}
+}
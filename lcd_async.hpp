@@ -0,0 +1,298 @@
+//
+// -- Description:
+// Coroutine API for HD44780 displays driven from a single event loop thread
+//
+// -- Features:
+// 1. Awaitable display operations: co_await lcd.print(...), co_await lcd.clear()
+// 2. Controller delays are timer suspensions, the loop thread never sleeps on a display
+// 3. Bus transfers run on the loop's I/O thread, so one loop thread serves many displays
+// 4. Integration with an external event loop: fd() becomes readable when I/O is
+//    completed, next_deadline() tells when the nearest timer expires
+//
+// An operation is encoded by the regular LCD1602 pipeline into expander byte runs with
+// controller delays between them. Then the runs are sent one by one with suspensions
+// in between. Operations on one display are applied atomically in submission order.
+// With bus locking enabled (hw::i2c_set_locking) the I/O thread holds the display's
+// lock for all runs of an operation, so other processes don't interleave with it.
+// Readback methods (verify_step, recover, calibrate) are not available asynchronously.
+//
+// Requires C++20 (make COROUTINES=1), the rest of the library is C++11.
+//
+
+#ifndef _LCD_ASYNC_HPP
+#define _LCD_ASYNC_HPP
+
+#if !defined(__cpp_impl_coroutine)
+#error "lcd_async.hpp requires C++20 coroutines support (-std=c++20)"
+#endif
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <chrono>
+#include <coroutine>
+
+#include "lcd1602.hpp"
+
+// Lazily started coroutine. Runs when awaited or spawned with LCDLoop::spawn().
+class LCDTask
+{
+public:
+	struct promise_type
+	{
+		std::coroutine_handle<> continuation;
+		std::exception_ptr error;
+
+		// Resumes the awaiting coroutine (symmetric transfer)
+		struct final_awaiter
+		{
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+				std::coroutine_handle<> next = h.promise().continuation;
+				return next ? next : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+
+		LCDTask get_return_object() { return LCDTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		final_awaiter final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { error = std::current_exception(); }
+	};
+
+	LCDTask(LCDTask &&other) noexcept: handle(other.handle) { other.handle = nullptr; }
+	~LCDTask() { if(handle) handle.destroy(); }
+
+	LCDTask(const LCDTask&) = delete;
+	LCDTask& operator=(const LCDTask&) = delete;
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	void await_resume() {
+		if(handle.promise().error){
+			std::rethrow_exception(handle.promise().error);
+		}
+	}
+
+private:
+	explicit LCDTask(std::coroutine_handle<promise_type> h): handle(h) {}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+// Single-threaded executor: timers and ready coroutines are processed by the thread
+// calling run() / poll(), blocking bus transfers by the internal I/O thread.
+// All methods except fd() must be called from the loop thread.
+class LCDLoop
+{
+public:
+	typedef std::chrono::steady_clock clock;
+
+	LCDLoop();
+	~LCDLoop();
+
+	LCDLoop(const LCDLoop&) = delete;
+	LCDLoop& operator=(const LCDLoop&) = delete;
+
+	// Starts the task immediately (up to its first suspension)
+	void spawn(LCDTask task);
+
+	// Processes events until all spawned tasks are finished
+	void run();
+
+	// Resumes ready coroutines and expired timers without blocking
+	void poll();
+	// Readable when poll() has I/O completions to process
+	int fd() const { return event_fd; }
+	// Returns false if no timers are pending
+	bool next_deadline(clock::time_point &tp) const;
+
+	// Resume h on the next poll()
+	void post(std::coroutine_handle<> h) { ready.push_back(h); }
+
+	struct timer_awaiter
+	{
+		LCDLoop &loop;
+		clock::time_point tp;
+
+		bool await_ready() const { return clock::now() >= tp; }
+		void await_suspend(std::coroutine_handle<> h) { loop.add_timer(tp, h); }
+		void await_resume() const {}
+	};
+
+	struct io_awaiter
+	{
+		LCDLoop &loop;
+		std::function<void()> fn;
+		std::exception_ptr error;
+
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { loop.add_io(this, h); }
+		void await_resume() {
+			if(error){
+				std::rethrow_exception(error);
+			}
+		}
+	};
+
+	timer_awaiter sleep_until(clock::time_point tp) { return timer_awaiter{*this, tp}; }
+	timer_awaiter sleep_for(clock::duration d) { return timer_awaiter{*this, clock::now() + d}; }
+	// Runs fn on the I/O thread, exception is rethrown to the awaiting coroutine
+	io_awaiter run_io(std::function<void()> fn) { return io_awaiter{*this, std::move(fn), nullptr}; }
+
+	// Spawned tasks finished with exception
+	uint64_t get_errors() const { return errors; }
+	const std::string& get_last_error() const { return last_error; }
+
+private:
+	// Fire-and-forget coroutine owning a spawned task
+	struct detached
+	{
+		struct promise_type
+		{
+			detached get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+
+	struct timer
+	{
+		clock::time_point tp;
+		uint64_t seq;				// FIFO order of timers with the same deadline
+		std::coroutine_handle<> h;
+
+		bool operator>(const timer &other) const {
+			return (tp != other.tp) ? (tp > other.tp) : (seq > other.seq);
+		}
+	};
+
+	struct io_job
+	{
+		io_awaiter *awaiter;
+		std::coroutine_handle<> h;
+	};
+
+	int event_fd = -1;
+	size_t active = 0;						// spawned tasks not finished yet
+	uint64_t timer_seq = 0;
+	std::deque<std::coroutine_handle<>> ready;
+	std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers;
+
+	uint64_t errors = 0;
+	std::string last_error;
+
+	// I/O thread queues (guarded by io_mutex)
+	std::mutex io_mutex;
+	std::condition_variable io_cv;
+	std::deque<io_job> io_jobs;
+	std::vector<std::coroutine_handle<>> io_done;
+	bool io_running = true;
+	std::thread io_thread;
+
+	static detached run_task(LCDLoop *loop, LCDTask task);
+	void add_timer(clock::time_point tp, std::coroutine_handle<> h);
+	void add_io(io_awaiter *awaiter, std::coroutine_handle<> h);
+	void io_run();
+};
+
+// Display with awaitable operations. Every operation is a task that completes when
+// the controller is ready for the next command.
+class LCDAsync
+{
+public:
+	typedef std::function<void(LCD1602&)> operation;
+
+	explicit LCDAsync(LCDLoop &loop, uint8_t lcd_addr = PCF8574A_ADDR): loop(loop), lcd(lcd_addr) {}
+
+	LCDAsync(const LCDAsync&) = delete;
+	LCDAsync& operator=(const LCDAsync&) = delete;
+
+	// Synchronous driver (must not be used while async operations are pending)
+	LCD1602& sync() { return lcd; }
+
+	// Any sequence of LCD1602 calls applied as one operation
+	LCDTask run(operation op);
+
+	LCDTask init(const std::string &i2c_dev = "") {
+		return this->run([i2c_dev](LCD1602 &lcd){ lcd.init(lcd.get_addr(), i2c_dev); });
+	}
+	LCDTask clear() { return this->run([](LCD1602 &lcd){ lcd.clear(); }); }
+	LCDTask return_home() { return this->run([](LCD1602 &lcd){ lcd.return_home(); }); }
+	LCDTask control(bool backlight, bool cursor = false, bool blink = false) {
+		return this->run([=](LCD1602 &lcd){ lcd.control(backlight, cursor, blink); });
+	}
+	LCDTask set_cursor(uint8_t row, uint8_t col) {
+		return this->run([=](LCD1602 &lcd){ lcd.set_cursor(row, col); });
+	}
+	LCDTask print(const std::string &str, LCD1602::Alignment align = LCD1602::Alignment::NO) {
+		return this->run([=](LCD1602 &lcd){ lcd.print(str, align); });
+	}
+	LCDTask print_ru(const std::string &str) {
+		return this->run([=](LCD1602 &lcd){ lcd.print_ru(str); });
+	}
+	LCDTask print_with_padding(const std::string &str, char symb = ' ') {
+		return this->run([=](LCD1602 &lcd){ lcd.print_with_padding(str, symb); });
+	}
+
+private:
+	// Driver, that records expander byte runs and delays instead of sending them
+	class recorder final: public LCD1602
+	{
+	public:
+		struct segment
+		{
+			std::vector<uint8_t> bytes;
+			uint32_t delay_us = 0;		// controller execution time after the run
+		};
+
+		explicit recorder(uint8_t lcd_addr): LCD1602(lcd_addr) {}
+
+		bool capturing = false;
+		uint32_t lead_us = 0;			// delay requested before the first run
+		std::vector<segment> segments;
+		LCDLoop::clock::time_point ready_at;
+
+		void send(const segment &s) { LCD1602::write_expander(s.bytes.data(), s.bytes.size()); }
+		void settle(uint32_t exec_us);
+
+	protected:
+		void write_expander(const uint8_t *buf, uint16_t len) override;
+		void set_ready_deadline(uint32_t exec_us) override;
+		void wait_ready_deadline() override;
+		// Captured runs are sent under the lock taken by LCDAsync::run()
+		bool bus_locking() const override { return !this->capturing; }
+	};
+
+	struct lock_awaiter
+	{
+		LCDAsync &owner;
+
+		bool await_ready();
+		void await_suspend(std::coroutine_handle<> h) { owner.waiters.push_back(h); }
+		void await_resume() const {}
+	};
+
+	LCDLoop &loop;
+	recorder lcd;
+
+	// Operations are serialized: the owner of the display sends its runs, others wait
+	bool busy = false;
+	std::deque<std::coroutine_handle<>> waiters;
+	void unlock();
+};
+
+#endif
@@ -0,0 +1,523 @@
+#include <cstring>
+
+#include "lcd_charset.hpp"
+
+#define PAGE_SIZE 				256
+
+// Katakana voiced / semi-voiced sound marks in A00 ROM
+#define KANA_DAKUTEN 			0xDE
+#define KANA_HANDAKUTEN 		0xDF
+
+struct rom_symb
+{
+	uint16_t cp;
+	uint8_t code;
+};
+
+struct translit_symb
+{
+	uint16_t cp;
+	const char *str;
+};
+
+struct glyph_symb
+{
+	uint16_t cp;
+	uint8_t bitmap[8];
+};
+
+// A00: ASCII except 0x5C (Yen sign) and 0x7E, 0x7F (arrows), katakana and Greek / math symbols
+static const rom_symb a00_symbols[] = {
+	{0x00A5, 0x5C}, // ¥
+	{0x2192, 0x7E}, // →
+	{0x2190, 0x7F}, // ←
+	{0x3002, 0xA1}, // 。
+	{0x300C, 0xA2}, // 「
+	{0x300D, 0xA3}, // 」
+	{0x3001, 0xA4}, // 、
+	{0x30FB, 0xA5}, // ・
+	{0x30FC, 0xB0}, // ー
+	{0x309B, 0xDE}, // ゛
+	{0x309C, 0xDF}, // ゜
+	{0x00B0, 0xDF}, // ° (semi-voiced mark looks like degree sign)
+	{0x03B1, 0xE0}, // α
+	{0x00E4, 0xE1}, // ä
+	{0x03B2, 0xE2}, // β
+	{0x03B5, 0xE3}, // ε
+	{0x03BC, 0xE4}, // μ
+	{0x00B5, 0xE4}, // µ
+	{0x03C3, 0xE5}, // σ
+	{0x03C1, 0xE6}, // ρ
+	{0x221A, 0xE8}, // √
+	{0x00A2, 0xEC}, // ¢
+	{0x00A3, 0xED}, // £
+	{0x00F1, 0xEE}, // ñ
+	{0x00F6, 0xEF}, // ö
+	{0x03B8, 0xF2}, // θ
+	{0x221E, 0xF3}, // ∞
+	{0x03A9, 0xF4}, // Ω
+	{0x00FC, 0xF5}, // ü
+	{0x03A3, 0xF6}, // Σ
+	{0x03C0, 0xF7}, // π
+	{0x5343, 0xFA}, // 千
+	{0x4E07, 0xFB}, // 万
+	{0x5186, 0xFC}, // 円
+	{0x00F7, 0xFD}, // ÷
+	{0x2588, 0xFF}, // █
+};
+
+// Full-width katakana U+30A1 - U+30F6 -> half-width A00 symbol + sound mark
+static const uint8_t a00_katakana[][2] = {
+	{0xA7, 0}, {0xB1, 0}, {0xA8, 0}, {0xB2, 0}, {0xA9, 0}, {0xB3, 0}, {0xAA, 0}, {0xB4, 0},
+	{0xAB, 0}, {0xB5, 0},
+	{0xB6, 0}, {0xB6, KANA_DAKUTEN}, {0xB7, 0}, {0xB7, KANA_DAKUTEN}, {0xB8, 0}, {0xB8, KANA_DAKUTEN},
+	{0xB9, 0}, {0xB9, KANA_DAKUTEN}, {0xBA, 0}, {0xBA, KANA_DAKUTEN},
+	{0xBB, 0}, {0xBB, KANA_DAKUTEN}, {0xBC, 0}, {0xBC, KANA_DAKUTEN}, {0xBD, 0}, {0xBD, KANA_DAKUTEN},
+	{0xBE, 0}, {0xBE, KANA_DAKUTEN}, {0xBF, 0}, {0xBF, KANA_DAKUTEN},
+	{0xC0, 0}, {0xC0, KANA_DAKUTEN}, {0xC1, 0}, {0xC1, KANA_DAKUTEN}, {0xAF, 0}, {0xC2, 0},
+	{0xC2, KANA_DAKUTEN}, {0xC3, 0}, {0xC3, KANA_DAKUTEN}, {0xC4, 0}, {0xC4, KANA_DAKUTEN},
+	{0xC5, 0}, {0xC6, 0}, {0xC7, 0}, {0xC8, 0}, {0xC9, 0},
+	{0xCA, 0}, {0xCA, KANA_DAKUTEN}, {0xCA, KANA_HANDAKUTEN}, {0xCB, 0}, {0xCB, KANA_DAKUTEN},
+	{0xCB, KANA_HANDAKUTEN}, {0xCC, 0}, {0xCC, KANA_DAKUTEN}, {0xCC, KANA_HANDAKUTEN}, {0xCD, 0},
+	{0xCD, KANA_DAKUTEN}, {0xCD, KANA_HANDAKUTEN}, {0xCE, 0}, {0xCE, KANA_DAKUTEN}, {0xCE, KANA_HANDAKUTEN},
+	{0xCF, 0}, {0xD0, 0}, {0xD1, 0}, {0xD2, 0}, {0xD3, 0},
+	{0xAC, 0}, {0xD4, 0}, {0xAD, 0}, {0xD5, 0}, {0xAE, 0}, {0xD6, 0},
+	{0xD7, 0}, {0xD8, 0}, {0xD9, 0}, {0xDA, 0}, {0xDB, 0},
+	{0xDC, 0}, {0xDC, 0}, {0xB2, 0}, {0xB4, 0}, {0xA6, 0}, {0xDD, 0}, {0xB3, KANA_DAKUTEN},
+	{0xB6, 0}, {0xB9, 0},
+};
+
+// A02: ASCII, Cyrillic capitals and Greek at 0x80 - 0x9F, Latin-1 compatible upper half
+static const rom_symb a02_symbols[] = {
+	{0x0411, 0x80}, // Б
+	{0x0414, 0x81}, // Д
+	{0x0416, 0x82}, // Ж
+	{0x0417, 0x83}, // З
+	{0x0418, 0x84}, // И
+	{0x0419, 0x85}, // Й
+	{0x041B, 0x86}, // Л
+	{0x041F, 0x87}, // П
+	{0x0423, 0x88}, // У
+	{0x0426, 0x89}, // Ц
+	{0x0427, 0x8A}, // Ч
+	{0x0428, 0x8B}, // Ш
+	{0x0429, 0x8C}, // Щ
+	{0x042A, 0x8D}, // Ъ
+	{0x042B, 0x8E}, // Ы
+	{0x042D, 0x8F}, // Э
+	{0x03B1, 0x90}, // α
+	{0x266A, 0x91}, // ♪
+	{0x0393, 0x92}, // Γ
+	{0x0413, 0x92}, // Г
+	{0x03C0, 0x93}, // π
+	{0x03A3, 0x94}, // Σ
+	{0x03C3, 0x95}, // σ
+	{0x03C4, 0x97}, // τ
+	{0x0398, 0x99}, // Θ
+	{0x03A9, 0x9A}, // Ω
+	{0x03B4, 0x9B}, // δ
+	{0x221E, 0x9C}, // ∞
+	{0x2665, 0x9D}, // ♥
+	{0x03B5, 0x9E}, // ε
+	{0x2229, 0x9F}, // ∩
+	{0x00A1, 0xA1}, // ¡
+	{0x00A2, 0xA2}, // ¢
+	{0x00A3, 0xA3}, // £
+	{0x00A5, 0xA5}, // ¥
+	{0x00A7, 0xA7}, // §
+	{0x00A9, 0xA9}, // ©
+	{0x00AB, 0xAB}, // «
+	{0x00B0, 0xB0}, // °
+	{0x00B1, 0xB1}, // ±
+	{0x00B2, 0xB2}, // ²
+	{0x00B3, 0xB3}, // ³
+	{0x00B5, 0xB5}, // µ
+	{0x00B6, 0xB6}, // ¶
+	{0x00B7, 0xB7}, // ·
+	{0x00B9, 0xB9}, // ¹
+	{0x00BB, 0xBB}, // »
+	{0x00BC, 0xBC}, // ¼
+	{0x00BD, 0xBD}, // ½
+	{0x00BE, 0xBE}, // ¾
+	{0x00BF, 0xBF}, // ¿
+};
+
+// WH1602B: ASCII and Cyrillic ROM
+static const rom_symb wh1602b_symbols[] = {
+	{0x0401, 162}, // Ё
+	{0x0411, 160}, // Б
+	{0x0413, 161}, // Г
+	{0x0414, 224}, // Д
+	{0x0416, 163}, // Ж
+	{0x0417, 164}, // З
+	{0x0418, 165}, // И
+	{0x0419, 166}, // Й
+	{0x041B, 167}, // Л
+	{0x041F, 168}, // П
+	{0x0423, 169}, // У
+	{0x0424, 170}, // Ф
+	{0x0426, 225}, // Ц
+	{0x0427, 171}, // Ч
+	{0x0428, 172}, // Ш
+	{0x0429, 226}, // Щ
+	{0x042A, 173}, // Ъ
+	{0x042B, 174}, // Ы
+	{0x042D, 175}, // Э
+	{0x042E, 176}, // Ю
+	{0x042F, 177}, // Я
+	{0x0431, 178}, // б
+	{0x0432, 179}, // в
+	{0x0433, 180}, // г
+	{0x0434, 227}, // д
+	{0x0451, 181}, // ё
+	{0x0436, 182}, // ж
+	{0x0437, 183}, // з
+	{0x0438, 184}, // и
+	{0x0439, 185}, // й
+	{0x043A, 186}, // к
+	{0x043B, 187}, // л
+	{0x043C, 188}, // м
+	{0x043D, 189}, // н
+	{0x043F, 190}, // п
+	{0x0442, 191}, // т
+	{0x0444, 228}, // ф
+	{0x0446, 229}, // ц
+	{0x0447, 192}, // ч
+	{0x0448, 193}, // ш
+	{0x0449, 230}, // щ
+	{0x044A, 194}, // ъ
+	{0x044B, 195}, // ы
+	{0x044C, 196}, // ь
+	{0x044D, 197}, // э
+	{0x044E, 198}, // ю
+	{0x044F, 199}, // я
+	{0x042C, 'b'}, // Ь
+	{0x00B0, 223}, // °
+};
+
+// RU letters that are equal to ENG symbols (all ROMs)
+static const rom_symb cyrillic_lookalikes[] = {
+	{0x0410, 'A'}, // А
+	{0x0412, 'B'}, // В
+	{0x0415, 'E'}, // Е
+	{0x0401, 'E'}, // Ё
+	{0x041A, 'K'}, // К
+	{0x041C, 'M'}, // М
+	{0x041D, 'H'}, // Н
+	{0x041E, 'O'}, // О
+	{0x0420, 'P'}, // Р
+	{0x0421, 'C'}, // С
+	{0x0422, 'T'}, // Т
+	{0x0425, 'X'}, // Х
+	{0x0430, 'a'}, // а
+	{0x0435, 'e'}, // е
+	{0x043E, 'o'}, // о
+	{0x0440, 'p'}, // р
+	{0x0441, 'c'}, // с
+	{0x0443, 'y'}, // у
+	{0x0445, 'x'}, // х
+};
+
+// Software generated symbols (uploaded to CGRAM on demand)
+static const glyph_symb glyphs[] = {
+	{0x0411, {0b11111,0b10000,0b10000,0b11110,0b10001,0b10001,0b11110,0b00000}}, // Б
+	{0x0413, {0b11111,0b10000,0b10000,0b10000,0b10000,0b10000,0b10000,0b00000}}, // Г
+	{0x0414, {0b00110,0b01010,0b01010,0b01010,0b01010,0b01010,0b11111,0b10001}}, // Д
+	{0x0416, {0b10101,0b10101,0b10101,0b01110,0b10101,0b10101,0b10101,0b00000}}, // Ж
+	{0x0417, {0b01110,0b10001,0b00001,0b00110,0b00001,0b10001,0b01110,0b00000}}, // З
+	{0x0418, {0b10001,0b10001,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}, // И
+	{0x0419, {0b10101,0b10001,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}, // Й
+	{0x041B, {0b00111,0b01001,0b01001,0b01001,0b01001,0b01001,0b10001,0b00000}}, // Л
+	{0x041F, {0b11111,0b10001,0b10001,0b10001,0b10001,0b10001,0b10001,0b00000}}, // П
+	{0x0423, {0b10001,0b10001,0b10001,0b01111,0b00001,0b10001,0b01110,0b00000}}, // У
+	{0x0424, {0b00100,0b01110,0b10101,0b10101,0b10101,0b01110,0b00100,0b00000}}, // Ф
+	{0x0426, {0b10010,0b10010,0b10010,0b10010,0b10010,0b10010,0b11111,0b00001}}, // Ц
+	{0x0427, {0b10001,0b10001,0b10001,0b01111,0b00001,0b00001,0b00001,0b00000}}, // Ч
+	{0x0428, {0b10001,0b10001,0b10001,0b10101,0b10101,0b10101,0b11111,0b00000}}, // Ш
+	{0x0429, {0b10001,0b10001,0b10001,0b10101,0b10101,0b10101,0b11111,0b00001}}, // Щ
+	{0x042A, {0b11000,0b01000,0b01000,0b01110,0b01001,0b01001,0b01110,0b00000}}, // Ъ
+	{0x042B, {0b10001,0b10001,0b10001,0b11101,0b10011,0b10011,0b11101,0b00000}}, // Ы
+	{0x042C, {0b10000,0b10000,0b10000,0b11110,0b10001,0b10001,0b11110,0b00000}}, // Ь
+	{0x042D, {0b01110,0b10001,0b00001,0b00111,0b00001,0b10001,0b01110,0b00000}}, // Э
+	{0x042E, {0b10010,0b10101,0b10101,0b11101,0b10101,0b10101,0b10010,0b00000}}, // Ю
+	{0x042F, {0b01111,0b10001,0b10001,0b01111,0b00101,0b01001,0b10001,0b00000}}, // Я
+	{0x0431, {0b00011,0b01100,0b10000,0b11110,0b10001,0b10001,0b01110,0b00000}}, // б
+	{0x0432, {0b00000,0b00000,0b11110,0b10001,0b11110,0b10001,0b11110,0b00000}}, // в
+	{0x0433, {0b00000,0b00000,0b11110,0b10000,0b10000,0b10000,0b10000,0b00000}}, // г
+	{0x0434, {0b00000,0b00000,0b00110,0b01010,0b01010,0b01010,0b11111,0b10001}}, // д
+	{0x0451, {0b01010,0b00000,0b01110,0b10001,0b11111,0b10000,0b01111,0b00000}}, // ё
+	{0x0436, {0b00000,0b00000,0b10101,0b10101,0b01110,0b10101,0b10101,0b00000}}, // ж
+	{0x0437, {0b00000,0b00000,0b01110,0b10001,0b00110,0b10001,0b01110,0b00000}}, // з
+	{0x0438, {0b00000,0b00000,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}, // и
+	{0x0439, {0b01010,0b00100,0b10001,0b10011,0b10101,0b11001,0b10001,0b00000}}, // й
+	{0x043A, {0b00000,0b00000,0b10010,0b10100,0b11000,0b10100,0b10010,0b00000}}, // к
+	{0x043B, {0b00000,0b00000,0b00111,0b01001,0b01001,0b01001,0b10001,0b00000}}, // л
+	{0x043C, {0b00000,0b00000,0b10001,0b11011,0b10101,0b10001,0b10001,0b00000}}, // м
+	{0x043D, {0b00000,0b00000,0b10001,0b10001,0b11111,0b10001,0b10001,0b00000}}, // н
+	{0x043F, {0b00000,0b00000,0b11111,0b10001,0b10001,0b10001,0b10001,0b00000}}, // п
+	{0x0442, {0b00000,0b00000,0b11111,0b00100,0b00100,0b00100,0b00100,0b00000}}, // т
+	{0x0444, {0b00000,0b00000,0b00100,0b01110,0b10101,0b01110,0b00100,0b00000}}, // ф
+	{0x0446, {0b00000,0b00000,0b10010,0b10010,0b10010,0b10010,0b11111,0b00001}}, // ц
+	{0x0447, {0b00000,0b00000,0b10001,0b10001,0b01111,0b00001,0b00001,0b00000}}, // ч
+	{0x0448, {0b00000,0b00000,0b10101,0b10101,0b10101,0b10101,0b11111,0b00000}}, // ш
+	{0x0449, {0b00000,0b00000,0b10101,0b10101,0b10101,0b10101,0b11111,0b00001}}, // щ
+	{0x044A, {0b00000,0b00000,0b11000,0b01000,0b01110,0b01001,0b01110,0b00000}}, // ъ
+	{0x044B, {0b00000,0b00000,0b10001,0b10001,0b11101,0b10011,0b11101,0b00000}}, // ы
+	{0x044C, {0b00000,0b00000,0b10000,0b10000,0b11110,0b10001,0b11110,0b00000}}, // ь
+	{0x044D, {0b00000,0b00000,0b01110,0b10001,0b00111,0b10001,0b01110,0b00000}}, // э
+	{0x044E, {0b00000,0b00000,0b10010,0b10101,0b11101,0b10101,0b10010,0b00000}}, // ю
+	{0x044F, {0b00000,0b00000,0b01111,0b10001,0b01111,0b00101,0b01001,0b00000}}, // я
+	{0x20AC, {0b00111,0b01000,0b11110,0b01000,0b11110,0b01000,0b00111,0b00000}}, // €
+};
+
+// Latin-1 letters U+00C0 - U+00FF without diacritics
+static const char *latin1_letters[] = {
+	"A", "A", "A", "A", "A", "A", "AE", "C", "E", "E", "E", "E", "I", "I", "I", "I",
+	"D", "N", "O", "O", "O", "O", "O", "x", "O", "U", "U", "U", "U", "Y", "Th", "ss",
+	"a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+	"d", "n", "o", "o", "o", "o", "o", ":", "o", "u", "u", "u", "u", "y", "th", "y",
+};
+
+// Latin Extended-A letters U+0100 - U+017F without diacritics ('*' - see translit_symbols)
+static const char latin_ext_letters[] =
+	"AaAaAaCcCcCcCcDdDdEeEeEeEeEeGgGgGgGgHhHhIiIiIiIiIi**JjKkkLlLlLlLlLlNnNnNnnNnOoOoOo**"
+	"RrRrRrSsSsSsSsTtTtTtUuUuUuUuUuUuWwYyYZzZzZzs";
+
+// Symbols converted to several ROM (ASCII) symbols
+static const translit_symb translit_symbols[] = {
+	{0x00A0, " "},		// no-break space
+	{0x00A1, "!"},		// ¡
+	{0x00A2, "c"},		// ¢
+	{0x00A3, "L"},		// £
+	{0x00A5, "Y"},		// ¥
+	{0x00A7, "S"},		// §
+	{0x00A9, "(c)"},	// ©
+	{0x00AB, "<<"},		// «
+	{0x00AD, "-"},		// soft hyphen
+	{0x00AE, "(R)"},	// ®
+	{0x00B0, "o"},		// °
+	{0x00B1, "+-"},		// ±
+	{0x00B2, "2"},		// ²
+	{0x00B3, "3"},		// ³
+	{0x00B5, "u"},		// µ
+	{0x00B7, "."},		// ·
+	{0x00B9, "1"},		// ¹
+	{0x00BB, ">>"},		// »
+	{0x00BC, "1/4"},	// ¼
+	{0x00BD, "1/2"},	// ½
+	{0x00BE, "3/4"},	// ¾
+	{0x00BF, "?"},		// ¿
+	{0x0132, "IJ"},		// Ĳ
+	{0x0133, "ij"},		// ĳ
+	{0x0152, "OE"},		// Œ
+	{0x0153, "oe"},		// œ
+	{0x2010, "-"},		// ‐
+	{0x2011, "-"},		// ‑
+	{0x2012, "-"},		// ‒
+	{0x2013, "-"},		// –
+	{0x2014, "-"},		// —
+	{0x2015, "-"},		// ―
+	{0x2018, "'"},		// ‘
+	{0x2019, "'"},		// ’
+	{0x201A, ","},		// ‚
+	{0x201C, "\""},		// “
+	{0x201D, "\""},		// ”
+	{0x201E, "\""},		// „
+	{0x2022, "*"},		// •
+	{0x2026, "..."},	// …
+	{0x2032, "'"},		// ′
+	{0x2033, "\""},		// ″
+	{0x2039, "<"},		// ‹
+	{0x203A, ">"},		// ›
+	{0x20AC, "EUR"},	// €
+	{0x2116, "N"},		// №
+	{0x2122, "TM"},		// ™
+	{0x2190, "<-"},		// ←
+	{0x2191, "^"},		// ↑
+	{0x2192, "->"},		// →
+	{0x2193, "v"},		// ↓
+	{0x2212, "-"},		// −
+	{0x2260, "!="},		// ≠
+	{0x2264, "<="},		// ≤
+	{0x2265, ">="},		// ≥
+};
+
+const LCDCharset& LCDCharset::get(Rom rom)
+{
+	static const LCDCharset a00(Rom::A00);
+	static const LCDCharset a02(Rom::A02);
+	static const LCDCharset wh1602b(Rom::WH1602B);
+
+	switch(rom){
+		case Rom::A02: return a02;
+		case Rom::WH1602B: return wh1602b;
+		default: return a00;
+	}
+}
+
+LCDCharset::LCDCharset(Rom rom): rom(rom), table(PAGE_SIZE, 0)
+{
+	memset(this->pages, 0, sizeof(this->pages));
+
+	// Index 0 is reserved, so translit() value is never 0
+	this->translits.push_back("");
+
+	// ROM symbols first: ASCII
+	for(uint8_t ch = 0x20; ch < 0x7E; ++ch){
+		if(rom != Rom::A00 || ch != '\\'){
+			this->add_rom(ch, ch);
+		}
+	}
+
+	if(rom != Rom::A00){
+		this->add_rom('~', '~');
+	}
+
+	// ROM specific symbols
+	if(rom == Rom::A00){
+		for(const rom_symb &s : a00_symbols){
+			this->add_rom(s.cp, s.code);
+		}
+
+		// Half-width katakana are at the same order as in JIS X 0201
+		for(uint32_t cp = 0xFF61; cp <= 0xFF9F; ++cp){
+			this->add_rom(cp, static_cast<uint8_t>(cp - 0xFF61 + 0xA1));
+		}
+
+		uint32_t cp = 0x30A1;
+		for(const auto &kana : a00_katakana){
+			if(kana[1]){
+				this->add_translit(cp, std::string{static_cast<char>(kana[0]), static_cast<char>(kana[1])});
+			}
+			else{
+				this->add_rom(cp, kana[0]);
+			}
+			++cp;
+		}
+	}
+	else if(rom == Rom::A02){
+		for(const rom_symb &s : a02_symbols){
+			this->add_rom(s.cp, s.code);
+		}
+
+		for(uint32_t cp = 0xC0; cp <= 0xFF; ++cp){
+			this->add_rom(cp, static_cast<uint8_t>(cp));
+		}
+	}
+	else if(rom == Rom::WH1602B){
+		for(const rom_symb &s : wh1602b_symbols){
+			this->add_rom(s.cp, s.code);
+		}
+	}
+
+	for(const rom_symb &s : cyrillic_lookalikes){
+		this->add_rom(s.cp, s.code);
+	}
+
+	// CGRAM glyphs for the rest
+	for(uint16_t idx = 0; idx < sizeof(glyphs) / sizeof(glyphs[0]); ++idx){
+		if( !this->covered(glyphs[idx].cp) ){
+			this->set(glyphs[idx].cp, GLYPH, idx);
+		}
+	}
+
+	// Transliteration fallbacks
+	for(const translit_symb &s : translit_symbols){
+		this->add_translit(s.cp, s.str);
+	}
+
+	for(uint32_t cp = 0xC0; cp <= 0xFF; ++cp){
+		this->add_translit(cp, latin1_letters[cp - 0xC0]);
+	}
+
+	for(uint32_t cp = 0x100; cp < 0x100 + sizeof(latin_ext_letters) - 1; ++cp){
+		char ch = latin_ext_letters[cp - 0x100];
+		if(ch != '*'){
+			this->add_translit(cp, std::string(1, ch));
+		}
+	}
+}
+
+void LCDCharset::set(uint32_t cp, kind k, uint16_t value)
+{
+	uint8_t &page = this->pages[cp >> 8];
+
+	if(page == 0){
+		page = static_cast<uint8_t>(this->table.size() / PAGE_SIZE);
+		this->table.resize(this->table.size() + PAGE_SIZE, 0);
+	}
+
+	this->table[(static_cast<uint32_t>(page) << 8) | (cp & 0xFF)] = (static_cast<uint16_t>(k) << 14) | value;
+}
+
+// Earlier conversions have priority
+void LCDCharset::add_rom(uint32_t cp, uint8_t code)
+{
+	if( !this->covered(cp) ){
+		this->set(cp, ROM, code);
+	}
+}
+
+// codes are ROM symbol codes. Common fallbacks use ASCII, it's at the same codes in all ROMs.
+void LCDCharset::add_translit(uint32_t cp, const std::string &codes)
+{
+	if(this->covered(cp) || codes.empty()){
+		return;
+	}
+
+	if(codes.size() == 1){
+		uint16_t entry = this->lookup(static_cast<uint8_t>(codes[0]));
+		if(kind_of(entry) == ROM){
+			this->set(cp, ROM, value_of(entry));
+		}
+		return;
+	}
+
+	this->set(cp, TRANSLIT, static_cast<uint16_t>(this->translits.size()));
+	this->translits.push_back(codes);
+}
+
+const uint8_t* LCDCharset::glyph(uint16_t idx) const
+{
+	return glyphs[idx].bitmap;
+}
+
+uint32_t LCDCharset::utf8_decode(const char *&str)
+{
+	const unsigned char *ptr = reinterpret_cast<const unsigned char*>(str);
+	uint32_t cp;
+	size_t len;
+
+	if((ptr[0] >> 7) == 0x00){
+		cp = ptr[0];
+		len = 1;
+	}
+	else if((ptr[0] & 0xE0) == 0xC0){
+		cp = ptr[0] & 0x1F;
+		len = 2;
+	}
+	else if((ptr[0] & 0xF0) == 0xE0){
+		cp = ptr[0] & 0x0F;
+		len = 3;
+	}
+	else if((ptr[0] & 0xF8) == 0xF0){
+		cp = ptr[0] & 0x07;
+		len = 4;
+	}
+	else{
+		++str;
+		return ptr[0];
+	}
+
+	for(size_t i = 1; i < len; ++i){
+		// Terminating zero also stops here
+		if((ptr[i] & 0xC0) != 0x80){
+			++str;
+			return ptr[0];
+		}
+		cp = (cp << 6) | (ptr[i] & 0x3F);
+	}
+
+	str += len;
+	return cp;
+}
@@ -0,0 +1,81 @@
+//
+// -- Description:
+// Unicode to HD44780 character codes conversion for different character ROMs
+//
+// -- Features:
+// 1. ROM variants: A00 (English / Japanese), A02 (Western European), WH1602B (Cyrillic)
+// 2. Dense per-ROM tables: conversion of a code point is one two-level table lookup
+// 3. Transliteration fallbacks into ROM symbols (accents, typographic symbols, katakana marks)
+// 4. CGRAM glyphs for symbols not covered by the ROM (e.g. Cyrillic on A00)
+//
+// Tables are built on the first use of the ROM variant. Priority of the conversions:
+// ROM symbol (including look-alikes), CGRAM glyph, transliteration, '?'.
+//
+
+#ifndef _LCD_CHARSET_HPP
+#define _LCD_CHARSET_HPP
+
+#include <cstdint>
+#include <vector>
+#include <string>
+
+class LCDCharset
+{
+public:
+	enum class Rom : char
+	{
+		A00 = 0,	// HD44780UA00 and most of the clones
+		A02,		// HD44780UA02
+		WH1602B,	// Winstar WH1602B-CTK with Cyrillic ROM
+	};
+
+	// Table entry: kind in 2 upper bits, value in the rest
+	enum kind : uint16_t
+	{
+		NONE = 0,
+		ROM = 1,		// value - ROM symbol code
+		GLYPH = 2,		// value - glyph() index
+		TRANSLIT = 3,	// value - translit() index
+	};
+
+	// Shared instance for the ROM variant
+	static const LCDCharset& get(Rom rom);
+
+	uint16_t lookup(uint32_t cp) const {
+		if(cp > MAX_CODE_POINT){
+			return 0;
+		}
+		return table[(static_cast<uint32_t>(pages[cp >> 8]) << 8) | (cp & 0xFF)];
+	}
+
+	static kind kind_of(uint16_t entry) { return static_cast<kind>(entry >> 14); }
+	static uint16_t value_of(uint16_t entry) { return entry & 0x3FFF; }
+
+	// 5x8 bitmap of the glyph
+	const uint8_t* glyph(uint16_t idx) const;
+	// ROM symbol codes, zero-terminated
+	const char* translit(uint16_t idx) const { return translits[idx].c_str(); }
+
+	Rom get_rom() const { return rom; }
+
+	// Decodes one UTF-8 symbol and moves str to the next one.
+	// Malformed octets are returned as is (one byte).
+	static uint32_t utf8_decode(const char *&str);
+
+private:
+	static const uint32_t MAX_CODE_POINT = 0xFFFF;
+
+	explicit LCDCharset(Rom rom);
+
+	Rom rom;
+	uint8_t pages[(MAX_CODE_POINT + 1) >> 8];	// code point page -> table page (0 - empty page)
+	std::vector<uint16_t> table;
+	std::vector<std::string> translits;
+
+	bool covered(uint32_t cp) const { return this->lookup(cp) != 0; }
+	void set(uint32_t cp, kind k, uint16_t value);
+	void add_rom(uint32_t cp, uint8_t code);
+	void add_translit(uint32_t cp, const std::string &codes);
+};
+
+#endif
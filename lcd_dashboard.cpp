@@ -0,0 +1,467 @@
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+extern "C"{
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+}
+
+#include "lcd_dashboard.hpp"
+#include "lcd_charset.hpp"
+#include "trace.hpp"
+
+#define MAX_VALUE_LEN 		256
+#define MAX_EVENTS 			16
+
+// epoll data of the service descriptors (others are entry indexes)
+#define EV_STOP 			UINT64_MAX
+#define EV_INOTIFY 			(UINT64_MAX - 1)
+
+static std::runtime_error sys_error(const std::string &what)
+{
+	return std::runtime_error(what + " failed: " + strerror(errno));
+}
+
+LCDDashboard::LCDDashboard(LCD1602 &lcd): lcd(lcd)
+{
+	this->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if(this->stop_fd < 0){
+		throw sys_error("eventfd");
+	}
+}
+
+LCDDashboard::~LCDDashboard()
+{
+	this->close_sources();
+	close(this->stop_fd);
+}
+
+void LCDDashboard::add(const region &r)
+{
+	if(r.width == 0 || r.path.empty()){
+		throw std::runtime_error("LCDDashboard: invalid region");
+	}
+
+	entry e;
+	e.r = r;
+	this->entries.push_back(e);
+}
+
+// Splits the line by whitespace, quoted values (key="a b") are kept whole
+static std::vector<std::string> split_config_line(const std::string &line)
+{
+	std::vector<std::string> tokens;
+	size_t i = 0;
+
+	while(i < line.size()){
+		while(i < line.size() && isspace(static_cast<unsigned char>(line[i]))){
+			++i;
+		}
+		if(i >= line.size() || line[i] == '#'){
+			break;
+		}
+
+		std::string tok;
+		bool quoted = false;
+
+		for( ; i < line.size() && (quoted || !isspace(static_cast<unsigned char>(line[i]))); ++i){
+			if(line[i] == '"'){
+				quoted = !quoted;
+			}
+			else{
+				tok += line[i];
+			}
+		}
+
+		tokens.push_back(tok);
+	}
+
+	return tokens;
+}
+
+void LCDDashboard::load_config(const std::string &path)
+{
+	FILE *fp = fopen(path.c_str(), "r");
+	if( !fp ){
+		throw sys_error("open config '" + path + "'");
+	}
+
+	char buf[512];
+	int line_num = 0;
+
+	while(fgets(buf, sizeof(buf), fp)){
+		++line_num;
+		std::vector<std::string> tok = split_config_line(buf);
+
+		if(tok.empty()){
+			continue;
+		}
+
+		std::string where = path + ":" + std::to_string(line_num) + ": ";
+
+		if(tok.size() < 4){
+			fclose(fp);
+			throw std::runtime_error(where + "expected <row> <col> <width> <source>");
+		}
+
+		region r;
+		r.row = static_cast<uint8_t>(atoi(tok[0].c_str()));
+		r.col = static_cast<uint8_t>(atoi(tok[1].c_str()));
+		r.width = static_cast<uint8_t>(atoi(tok[2].c_str()));
+
+		const std::string &src = tok[3];
+		size_t colon = src.find(':');
+		std::string kind = src.substr(0, colon);
+
+		if(colon == std::string::npos || colon + 1 == src.size()){
+			fclose(fp);
+			throw std::runtime_error(where + "expected <file | watch | pipe>:<path>");
+		}
+		else if(kind == "file"){
+			r.source = Source::FILE;
+		}
+		else if(kind == "watch"){
+			r.source = Source::WATCH;
+		}
+		else if(kind == "pipe"){
+			r.source = Source::PIPE;
+		}
+		else{
+			fclose(fp);
+			throw std::runtime_error(where + "unsupported source: " + kind);
+		}
+		r.path = src.substr(colon + 1);
+
+		for(size_t i = 4; i < tok.size(); ++i){
+			size_t eq = tok[i].find('=');
+			std::string key = tok[i].substr(0, eq);
+			std::string value = (eq == std::string::npos) ? "" : tok[i].substr(eq + 1);
+
+			if(key == "period"){
+				r.period_ms = static_cast<unsigned>(atoi(value.c_str()));
+			}
+			else if(key == "field"){
+				r.field = atoi(value.c_str());
+			}
+			else if(key == "label"){
+				r.label = value;
+			}
+			else{
+				fclose(fp);
+				throw std::runtime_error(where + "unsupported option: " + key);
+			}
+		}
+
+		if(r.width == 0 || r.period_ms == 0){
+			fclose(fp);
+			throw std::runtime_error(where + "width and period must be positive");
+		}
+
+		this->add(r);
+	}
+
+	fclose(fp);
+}
+
+void LCDDashboard::open_sources()
+{
+	this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if(this->epoll_fd < 0){
+		throw sys_error("epoll_create1");
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u64 = EV_STOP;
+	if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->stop_fd, &ev) < 0){
+		throw sys_error("epoll_ctl");
+	}
+
+	for(size_t i = 0; i < this->entries.size(); ++i){
+		entry &e = this->entries[i];
+		ev.events = EPOLLIN;
+		ev.data.u64 = i;
+
+		if(e.r.source == Source::FILE){
+			e.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+			if(e.fd < 0){
+				throw sys_error("timerfd_create");
+			}
+
+			struct itimerspec its;
+			its.it_interval.tv_sec = e.r.period_ms / 1000;
+			its.it_interval.tv_nsec = (e.r.period_ms % 1000) * 1000000L;
+			its.it_value = its.it_interval;
+			timerfd_settime(e.fd, 0, &its, nullptr);
+		}
+		else if(e.r.source == Source::PIPE){
+			// Opened for writing too: no hangups while there are no writers
+			e.fd = open(e.r.path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+			if(e.fd < 0){
+				throw sys_error("open pipe '" + e.r.path + "'");
+			}
+		}
+		else{
+			if(this->inotify_fd < 0){
+				this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+				if(this->inotify_fd < 0){
+					throw sys_error("inotify_init1");
+				}
+
+				struct epoll_event iev;
+				iev.events = EPOLLIN;
+				iev.data.u64 = EV_INOTIFY;
+				if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->inotify_fd, &iev) < 0){
+					throw sys_error("epoll_ctl");
+				}
+			}
+
+			// Directory is watched: files are often replaced by rename
+			size_t slash = e.r.path.rfind('/');
+			std::string dir = (slash == std::string::npos) ? "." : (slash ? e.r.path.substr(0, slash) : "/");
+			e.name = (slash == std::string::npos) ? e.r.path : e.r.path.substr(slash + 1);
+
+			e.wd = inotify_add_watch(this->inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MODIFY);
+			if(e.wd < 0){
+				throw sys_error("inotify_add_watch '" + dir + "'");
+			}
+			continue;
+		}
+
+		if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, e.fd, &ev) < 0){
+			throw sys_error("epoll_ctl '" + e.r.path + "'");
+		}
+	}
+}
+
+void LCDDashboard::close_sources()
+{
+	for(entry &e : this->entries){
+		if(e.fd >= 0){
+			close(e.fd);
+			e.fd = -1;
+		}
+		e.wd = -1;
+	}
+
+	if(this->inotify_fd >= 0){
+		close(this->inotify_fd);
+		this->inotify_fd = -1;
+	}
+
+	if(this->epoll_fd >= 0){
+		close(this->epoll_fd);
+		this->epoll_fd = -1;
+	}
+}
+
+// Value of the line: whole line or its field
+static std::string select_field(const std::string &line, int field)
+{
+	size_t end = line.find_last_not_of(" \t\r\n");
+	std::string value = (end == std::string::npos) ? "" : line.substr(0, end + 1);
+
+	if(field < 0){
+		return value;
+	}
+
+	size_t pos = 0;
+	for(int i = 0; ; ++i){
+		pos = value.find_first_not_of(" \t", pos);
+		if(pos == std::string::npos){
+			return "";
+		}
+
+		size_t next = value.find_first_of(" \t", pos);
+		if(i == field){
+			return value.substr(pos, next - pos);
+		}
+		pos = next;
+	}
+}
+
+// Missing file is shown as empty value
+void LCDDashboard::read_file(entry &e)
+{
+	++this->stats.reads;
+
+	char buf[MAX_VALUE_LEN];
+	ssize_t len = -1;
+	int fd = open(e.r.path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd >= 0){
+		len = read(fd, buf, sizeof(buf) - 1);
+		close(fd);
+	}
+
+	if(len < 0){
+		e.value.clear();
+		return;
+	}
+
+	buf[len] = '\0';
+	char *nl = strchr(buf, '\n');
+	if(nl){
+		*nl = '\0';
+	}
+
+	e.value = select_field(buf, e.r.field);
+}
+
+// Last complete line is shown
+void LCDDashboard::read_pipe(entry &e)
+{
+	char buf[MAX_VALUE_LEN];
+	ssize_t len;
+
+	while((len = read(e.fd, buf, sizeof(buf))) > 0){
+		++this->stats.reads;
+		e.pending.append(buf, len);
+	}
+
+	size_t nl = e.pending.rfind('\n');
+	if(nl == std::string::npos){
+		// Garbage without newlines is not accumulated forever
+		if(e.pending.size() > MAX_VALUE_LEN){
+			e.pending.clear();
+		}
+		return;
+	}
+
+	size_t start = e.pending.rfind('\n', nl ? nl - 1 : 0);
+	start = (start == std::string::npos || start >= nl) ? 0 : start + 1;
+
+	e.value = select_field(e.pending.substr(start, nl - start), e.r.field);
+	e.pending.erase(0, nl + 1);
+}
+
+// Text is cut or padded to the region width (in display cells, transliterated symbols
+// take several of them and are never split)
+void LCDDashboard::render(entry &e)
+{
+	std::string text = e.r.label + e.value;
+	std::string fitted;
+	const char *str = text.c_str();
+	unsigned cells = 0;
+
+	while(*str){
+		const char *begin = str;
+		size_t width = this->lcd.symbol_width(LCDCharset::utf8_decode(str));
+
+		if(cells + width > e.r.width){
+			break;
+		}
+		fitted.append(begin, str - begin);
+		cells += width;
+	}
+	fitted.append(e.r.width - cells, ' ');
+
+	if(fitted == e.shown){
+		return;
+	}
+
+	TRACE_SPAN("LCDDashboard::render", "lcd");
+	++this->stats.renders;
+
+	// Unchanged cells of the region are not sent
+	this->lcd.begin_frame();
+	this->lcd.set_cursor(e.r.row, e.r.col);
+	this->lcd.print_ru(fitted);
+	this->lcd.commit_frame();
+
+	e.shown = fitted;
+}
+
+void LCDDashboard::run()
+{
+	this->open_sources();
+
+	try{
+		for(entry &e : this->entries){
+			if(e.r.source != Source::PIPE){
+				this->read_file(e);
+			}
+			this->render(e);
+		}
+
+		struct epoll_event events[MAX_EVENTS];
+
+		for(;;){
+			int num = epoll_wait(this->epoll_fd, events, MAX_EVENTS, -1);
+			if(num < 0){
+				if(errno == EINTR){
+					continue;
+				}
+				throw sys_error("epoll_wait");
+			}
+
+			++this->stats.wakeups;
+
+			for(int i = 0; i < num; ++i){
+				uint64_t id = events[i].data.u64;
+
+				if(id == EV_STOP){
+					uint64_t cnt;
+					ssize_t res = read(this->stop_fd, &cnt, sizeof(cnt));
+					(void)res;
+					this->close_sources();
+					return;
+				}
+
+				if(id == EV_INOTIFY){
+					alignas(struct inotify_event) char buf[4096];
+					ssize_t len;
+
+					while((len = read(this->inotify_fd, buf, sizeof(buf))) > 0){
+						for(char *p = buf; p < buf + len; ){
+							const struct inotify_event *ev = reinterpret_cast<const struct inotify_event*>(p);
+
+							for(entry &e : this->entries){
+								if(ev->len && e.wd == ev->wd && e.name == ev->name){
+									this->read_file(e);
+									this->render(e);
+								}
+							}
+
+							p += sizeof(struct inotify_event) + ev->len;
+						}
+					}
+					continue;
+				}
+
+				entry &e = this->entries[id];
+
+				if(e.r.source == Source::FILE){
+					uint64_t expirations;
+					ssize_t res = read(e.fd, &expirations, sizeof(expirations));
+					(void)res;
+					this->read_file(e);
+				}
+				else{
+					this->read_pipe(e);
+				}
+
+				this->render(e);
+			}
+		}
+	}
+	catch(...){
+		this->close_sources();
+		throw;
+	}
+}
+
+void LCDDashboard::stop()
+{
+	uint64_t one = 1;
+	ssize_t res = write(this->stop_fd, &one, sizeof(one));
+	(void)res;
+}
@@ -0,0 +1,104 @@
+//
+// -- Description:
+// Event-driven dashboard: values of files and pipes shown in screen regions
+//
+// -- Features:
+// 1. Sources: polled files (sysfs, procfs), watched files (inotify, rewritten or renamed
+//    into place by applications) and named pipes (last received line is shown)
+// 2. One epoll loop for timers (timerfd), inotify and pipes: idle dashboard sleeps
+// 3. Only regions with changed text are rendered, and only changed cells are sent
+//    (frame commit), so unchanged values cost no bus traffic
+//
+// Config file: one region per line, '#' - comment
+//     <row> <col> <width> <file:path | watch:path | pipe:path> [period=<ms>] [field=<n>] [label="<text>"]
+// period - polling period of file sources (1000 ms by default), field - whitespace separated
+// field of the first line (0 - first, whole line by default), label - text before the value.
+//
+// Example:
+//     0 0 16 file:/proc/loadavg field=0 label="Load "
+//     1 0 8 file:/sys/class/thermal/thermal_zone0/temp period=5000 label="T "
+//     1 8 8 watch:/run/app/status
+//
+
+#ifndef _LCD_DASHBOARD_HPP
+#define _LCD_DASHBOARD_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lcd1602.hpp"
+
+class LCDDashboard
+{
+public:
+	enum class Source : char
+	{
+		FILE = 0,	// polled with period_ms
+		WATCH,		// inotify on the parent directory
+		PIPE,		// named pipe (FIFO)
+	};
+
+	struct region
+	{
+		uint8_t row = 0;
+		uint8_t col = 0;
+		uint8_t width = 16;
+		Source source = Source::FILE;
+		std::string path;
+		std::string label;
+		int field = -1;				// whitespace separated field (-1 - whole line)
+		unsigned period_ms = 1000;
+	};
+
+	struct statistics
+	{
+		uint64_t wakeups = 0;		// epoll returns
+		uint64_t reads = 0;			// source reads
+		uint64_t renders = 0;		// regions rendered (text changed)
+	};
+
+	explicit LCDDashboard(LCD1602 &lcd);
+	~LCDDashboard();
+
+	LCDDashboard(const LCDDashboard&) = delete;
+	LCDDashboard& operator=(const LCDDashboard&) = delete;
+
+	void add(const region &r);
+	// Throws std::runtime_error with the line number on errors
+	void load_config(const std::string &path);
+
+	// Shows all regions, then renders changes until stop(). Throws std::runtime_error.
+	void run();
+	// Can be called from other threads and signal handlers
+	void stop();
+
+	statistics get_statistics() const { return stats; }
+
+private:
+	struct entry
+	{
+		region r;
+		int fd = -1;				// timerfd (FILE) or pipe (PIPE)
+		int wd = -1;				// inotify watch (WATCH)
+		std::string name;			// file name in the watched directory
+		std::string pending;		// incomplete line from the pipe
+		std::string value;
+		std::string shown;
+	};
+
+	LCD1602 &lcd;
+	std::vector<entry> entries;
+	int epoll_fd = -1;
+	int inotify_fd = -1;
+	int stop_fd = -1;
+	statistics stats;
+
+	void open_sources();
+	void close_sources();
+	void read_file(entry &e);
+	void read_pipe(entry &e);
+	void render(entry &e);
+};
+
+#endif
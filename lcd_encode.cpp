@@ -0,0 +1,90 @@
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "lcd_encode.hpp"
+
+#define PIN_EN 		( (uint8_t)(1 << 2) )	// Enable sending (see lcd1602.cpp)
+
+// Byte -> 4 expander bytes without control bits (memory order)
+struct encode_table
+{
+	uint8_t bytes[256][4];
+
+	encode_table()
+	{
+		for(int b = 0; b < 256; ++b){
+			uint8_t up = b & 0xF0;
+			uint8_t lo = (b << 4) & 0xF0;
+
+			bytes[b][0] = up | PIN_EN;
+			bytes[b][1] = up;
+			bytes[b][2] = lo | PIN_EN;
+			bytes[b][3] = lo;
+		}
+	}
+};
+
+static const encode_table table_;
+
+size_t lcd_encode_4bit(const uint8_t *data, size_t len, uint8_t flags, uint8_t *out)
+{
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	// 16 bytes -> 64: nibbles are duplicated and interleaved by unpacks
+	const __m128i mask = _mm_set1_epi8(static_cast<char>(0xF0));
+	const __m128i ctrl = _mm_set1_epi32(static_cast<int>((flags | PIN_EN) | (flags << 8) | ((flags | PIN_EN) << 16) | (static_cast<uint32_t>(flags) << 24)));
+
+	for( ; i + 16 <= len; i += 16){
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		__m128i up = _mm_and_si128(d, mask);
+		__m128i lo = _mm_and_si128(_mm_slli_epi16(d, 4), mask);
+
+		__m128i up2 = _mm_unpacklo_epi8(up, up);		// u0 u0 u1 u1 ... u7 u7
+		__m128i lo2 = _mm_unpacklo_epi8(lo, lo);
+		__m128i up2h = _mm_unpackhi_epi8(up, up);		// u8 u8 ... u15 u15
+		__m128i lo2h = _mm_unpackhi_epi8(lo, lo);
+
+		uint8_t *o = out + i * 4;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o), _mm_or_si128(_mm_unpacklo_epi16(up2, lo2), ctrl));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o + 16), _mm_or_si128(_mm_unpackhi_epi16(up2, lo2), ctrl));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o + 32), _mm_or_si128(_mm_unpacklo_epi16(up2h, lo2h), ctrl));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(o + 48), _mm_or_si128(_mm_unpackhi_epi16(up2h, lo2h), ctrl));
+	}
+#elif defined(__ARM_NEON)
+	// 16 bytes -> 64: interleaving store of the four expander byte streams
+	const uint8x16_t mask = vdupq_n_u8(0xF0);
+	const uint8x16_t f = vdupq_n_u8(flags);
+	const uint8x16_t fen = vdupq_n_u8(flags | PIN_EN);
+
+	for( ; i + 16 <= len; i += 16){
+		uint8x16_t d = vld1q_u8(data + i);
+		uint8x16_t up = vandq_u8(d, mask);
+		uint8x16_t lo = vshlq_n_u8(d, 4);
+		uint8x16x4_t o;
+
+		o.val[0] = vorrq_u8(up, fen);
+		o.val[1] = vorrq_u8(up, f);
+		o.val[2] = vorrq_u8(lo, fen);
+		o.val[3] = vorrq_u8(lo, f);
+		vst4q_u8(out + i * 4, o);
+	}
+#endif
+
+	// Tail (or everything without SIMD): table lookup, control bits as one word
+	uint32_t ctrl_word = flags * 0x01010101U;
+
+	for( ; i < len; ++i){
+		uint32_t w;
+		memcpy(&w, table_.bytes[data[i]], 4);
+		w |= ctrl_word;
+		memcpy(out + i * 4, &w, 4);
+	}
+
+	return len * 4;
+}
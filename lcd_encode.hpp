@@ -0,0 +1,24 @@
+//
+// -- Description:
+// Encoding of HD44780 4-bit transfers into PCF8574 expander byte streams
+//
+// -- Features:
+// 1. Lookup table for the nibbles placement, control bits are OR-ed as one word
+// 2. SIMD encoding of long runs (SSE2 or NEON, chosen at compile time), scalar fallback
+//
+// Output of one byte: upper nibble with EN, upper nibble, lower nibble with EN, lower nibble
+// (D4..D7 on P4..P7). Used by LCD1602 for every transfer, so runs encoded in bulk are
+// identical to the byte by byte sending.
+//
+
+#ifndef _LCD_ENCODE_HPP
+#define _LCD_ENCODE_HPP
+
+#include <cstdint>
+#include <cstddef>
+
+// Encodes len bytes into 4 * len expander bytes at out. flags (RS, R/W, backlight bits
+// of the expander) are set in every output byte. Returns number of written bytes.
+size_t lcd_encode_4bit(const uint8_t *data, size_t len, uint8_t flags, uint8_t *out);
+
+#endif
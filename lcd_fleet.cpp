@@ -0,0 +1,201 @@
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "lcd_fleet.hpp"
+#include "trace.hpp"
+
+// Unchanged cells written through instead of moving the address counter
+// (one cell costs as much as the address setting command)
+#define MAX_GAP 		1
+
+// Changed bytes mask of CHUNK (32) bytes
+static inline uint32_t chunk_mask(const uint8_t *a, const uint8_t *b)
+{
+#if defined(__AVX2__)
+	__m256i va = _mm256_load_si256(reinterpret_cast<const __m256i*>(a));
+	__m256i vb = _mm256_load_si256(reinterpret_cast<const __m256i*>(b));
+	return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+#elif defined(__SSE2__)
+	__m128i a0 = _mm_load_si128(reinterpret_cast<const __m128i*>(a));
+	__m128i b0 = _mm_load_si128(reinterpret_cast<const __m128i*>(b));
+	__m128i a1 = _mm_load_si128(reinterpret_cast<const __m128i*>(a + 16));
+	__m128i b1 = _mm_load_si128(reinterpret_cast<const __m128i*>(b + 16));
+	uint32_t eq = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0))) |
+		(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1))) << 16);
+	return ~eq;
+#elif defined(__ARM_NEON)
+	// Bit weights of the lanes, pairwise additions collect them into mask bytes
+	static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+	uint8x16_t w = vld1q_u8(weights);
+	uint32_t mask = 0;
+
+	for(int half = 0; half < 2; ++half){
+		uint8x16_t ne = vmvnq_u8(vceqq_u8(vld1q_u8(a + half * 16), vld1q_u8(b + half * 16)));
+		uint8x16_t bits = vandq_u8(ne, w);
+		uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+		sum = vpadd_u8(sum, sum);
+		sum = vpadd_u8(sum, sum);
+		mask |= (static_cast<uint32_t>(vget_lane_u8(sum, 0)) | (static_cast<uint32_t>(vget_lane_u8(sum, 1)) << 8)) << (half * 16);
+	}
+
+	return mask;
+#else
+	uint32_t mask = 0;
+
+	for(size_t i = 0; i < 32; ++i){
+		mask |= static_cast<uint32_t>(a[i] != b[i]) << i;
+	}
+
+	return mask;
+#endif
+}
+
+LCDFleet::LCDFleet(size_t displays, uint8_t rows, uint8_t cols): displays(displays), rows(rows), cols(cols)
+{
+	if(rows == 0 || cols == 0){
+		throw std::runtime_error("LCDFleet: invalid display geometry");
+	}
+
+	this->stride = (static_cast<size_t>(rows) * cols + CHUNK - 1) / CHUNK * CHUNK;
+	this->words = this->stride / CHUNK;
+
+	// Both arrays in one allocation, aligned for the widest loads
+	this->storage.resize(2 * displays * this->stride + CHUNK);
+	uintptr_t base = reinterpret_cast<uintptr_t>(this->storage.data());
+	this->shown_buf = this->storage.data() + ((CHUNK - base % CHUNK) % CHUNK);
+	this->target_buf = this->shown_buf + displays * this->stride;
+
+	memset(this->shown_buf, ' ', 2 * displays * this->stride);
+
+	this->masks.assign(displays * this->words, 0);
+	this->forced.assign(displays, 0);
+}
+
+void LCDFleet::put(size_t display, uint8_t row, uint8_t col, const std::string &codes)
+{
+	if(display >= this->displays || row >= this->rows || col >= this->cols){
+		return;
+	}
+
+	size_t len = codes.size();
+	if(len > static_cast<size_t>(this->cols - col)){
+		len = this->cols - col;
+	}
+
+	memcpy(this->target(display, row) + col, codes.data(), len);
+}
+
+void LCDFleet::clear(size_t display)
+{
+	memset(this->target_buf + display * this->stride, ' ', static_cast<size_t>(this->rows) * this->cols);
+}
+
+// Padding after the last row is equal in both arrays, so it never shows up in the masks
+void LCDFleet::diff()
+{
+	TRACE_SPAN("LCDFleet::diff", "lcd");
+
+	size_t chunks = this->displays * this->words;
+	const uint8_t *shown = this->shown_buf;
+	const uint8_t *target = this->target_buf;
+	uint32_t *mask = this->masks.data();
+
+	for(size_t i = 0; i < chunks; ++i){
+		mask[i] = chunk_mask(shown + i * CHUNK, target + i * CHUNK);
+	}
+
+	for(size_t d = 0; d < this->displays; ++d){
+		if( !this->forced[d] ){
+			continue;
+		}
+
+		size_t cells = static_cast<size_t>(this->rows) * this->cols;
+		for(size_t i = 0; i < cells; ++i){
+			mask[d * this->words + i / 32] |= 1U << (i % 32);
+		}
+	}
+}
+
+bool LCDFleet::changed(size_t display) const
+{
+	for(size_t w = 0; w < this->words; ++w){
+		if(this->masks[display * this->words + w]){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void LCDFleet::changes(size_t display, std::vector<run> &runs) const
+{
+	runs.clear();
+
+	const uint32_t *mask = this->masks.data() + display * this->words;
+	const uint8_t *target = this->target_buf + display * this->stride;
+	int last = -1;		// last changed cell of the current run
+
+	for(size_t w = 0; w < this->words; ++w){
+		uint32_t m = mask[w];
+
+		while(m){
+			int cell = static_cast<int>(w * 32) + __builtin_ctz(m);
+			m &= m - 1;
+
+			int row = cell / this->cols;
+			int col = cell % this->cols;
+
+			if( !runs.empty() && (last / this->cols == row) && (cell - last - 1 <= MAX_GAP) ){
+				runs.back().len = static_cast<uint8_t>(col - runs.back().col + 1);
+			}
+			else{
+				runs.push_back(run{static_cast<uint8_t>(row), static_cast<uint8_t>(col), 1, target + cell});
+			}
+
+			last = cell;
+		}
+	}
+}
+
+void LCDFleet::commit(size_t display)
+{
+	memcpy(this->shown_buf + display * this->stride, this->target_buf + display * this->stride, this->stride);
+
+	for(size_t w = 0; w < this->words; ++w){
+		this->masks[display * this->words + w] = 0;
+	}
+
+	this->forced[display] = 0;
+}
+
+void LCDFleet::apply(size_t display, LCD1602 &lcd)
+{
+	TRACE_SPAN("LCDFleet::apply", "lcd");
+
+	std::vector<run> runs;
+	this->changes(display, runs);
+
+	if(runs.empty()){
+		return;
+	}
+
+	uint8_t cur_row = lcd.get_current_row();
+	uint8_t cur_col = lcd.get_current_col();
+
+	for(const run &r : runs){
+		// Skipped by the driver if the address counter is already there
+		lcd.set_cursor(r.row, r.col);
+
+		// Raw codes: no charset conversion
+		lcd.print_codes(r.codes, r.len);
+	}
+
+	lcd.set_cursor(cur_row, cur_col);
+	this->commit(display);
+}
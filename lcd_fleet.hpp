@@ -0,0 +1,87 @@
+//
+// -- Description:
+// Frame store for large sets of displays (hundreds of panels driven from one host)
+//
+// -- Features:
+// 1. Struct-of-arrays layout: shown and target DDRAM contents of all displays are kept
+//    in two contiguous 32-byte aligned arrays (one 32-byte aligned block per display)
+// 2. One pass diff of the whole fleet with SIMD compares (AVX2, SSE2 or NEON, chosen at
+//    compile time, scalar fallback otherwise), result is a changed-cells bitmask per display
+// 3. Compact per-display change lists (runs of cells in a row) for the bus workers
+//
+// Cells hold display character codes (ROM symbols or CGRAM locations 0-7).
+// Targets are set and diff() is called by one thread, then each display's changes can be
+// sent by its own worker (changes(), apply() and commit() of different displays don't
+// conflict). Build with -mavx2 (or -march=native) to use AVX2.
+//
+
+#ifndef _LCD_FLEET_HPP
+#define _LCD_FLEET_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <string>
+
+#include "lcd1602.hpp"
+
+class LCDFleet
+{
+public:
+	// Run of changed cells in a row
+	struct run
+	{
+		uint8_t row;
+		uint8_t col;
+		uint8_t len;
+		const uint8_t *codes;	// points to the target contents
+	};
+
+	// All displays are cleared (spaces shown)
+	LCDFleet(size_t displays, uint8_t rows = 2, uint8_t cols = 16);
+
+	LCDFleet(const LCDFleet&) = delete;
+	LCDFleet& operator=(const LCDFleet&) = delete;
+
+	size_t size() const { return displays; }
+
+	// Target contents
+	uint8_t* target(size_t display, uint8_t row) { return this->target_buf + display * this->stride + row * this->cols; }
+	// Writes codes at the position (clipped by the row end)
+	void put(size_t display, uint8_t row, uint8_t col, const std::string &codes);
+	// Fills the target with spaces
+	void clear(size_t display);
+
+	// Computes changed cells of all displays
+	void diff();
+	// Changed cells of the display (after diff()). Unchanged cells between close changes are
+	// included in the run when it's cheaper than a new cursor setting.
+	void changes(size_t display, std::vector<run> &runs) const;
+	bool changed(size_t display) const;
+	// Target is shown: display is up to date
+	void commit(size_t display);
+
+	// Sends changes to the display and commits them. Cursor position is restored.
+	void apply(size_t display, LCD1602 &lcd);
+
+	// Shown contents are unknown (e.g. display was reinitialized): next diff() reports
+	// all cells of the display
+	void invalidate(size_t display) { forced[display] = 1; }
+
+private:
+	static const size_t CHUNK = 32;			// bytes compared per mask word
+
+	size_t displays;
+	uint8_t rows;
+	uint8_t cols;
+	size_t stride;							// display block size (multiple of CHUNK)
+	size_t words;							// mask words per display
+
+	std::vector<uint8_t> storage;
+	uint8_t *shown_buf = nullptr;
+	uint8_t *target_buf = nullptr;
+	std::vector<uint32_t> masks;			// bit per cell: changed
+	std::vector<uint8_t> forced;
+};
+
+#endif
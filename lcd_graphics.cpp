@@ -0,0 +1,303 @@
+#include <algorithm>
+
+#include "lcd_graphics.hpp"
+
+// ROM symbols used by renderer
+#define SYMB_BLANK 				0x20
+#define SYMB_FULL 				0xFF
+
+// Big digits building blocks
+#define BD_BL 					0	// blank
+#define BD_FL 					1	// full block
+#define BD_UP 					2	// upper bar
+#define BD_LO 					3	// lower bar
+#define BD_UL 					4	// upper + lower bars
+
+#define BD_WIDTH 				3
+
+static const LCDGraphics::bitmap bd_bitmaps[] = {
+	{{0, 0, 0, 0, 0, 0, 0, 0}},
+	{{0, 0, 0, 0, 0, 0, 0, 0}},
+	{{0b11111,0b11111,0b00000,0b00000,0b00000,0b00000,0b00000,0b00000}},
+	{{0b00000,0b00000,0b00000,0b00000,0b00000,0b00000,0b11111,0b11111}},
+	{{0b11111,0b11111,0b00000,0b00000,0b00000,0b00000,0b11111,0b11111}},
+};
+
+// Digits 0-9: upper row cells, lower row cells
+static const uint8_t bd_digits[10][2][BD_WIDTH] = {
+	{{BD_FL, BD_UP, BD_FL}, {BD_FL, BD_LO, BD_FL}}, // 0
+	{{BD_UP, BD_FL, BD_BL}, {BD_LO, BD_FL, BD_LO}}, // 1
+	{{BD_UL, BD_UL, BD_FL}, {BD_FL, BD_LO, BD_LO}}, // 2
+	{{BD_UL, BD_UL, BD_FL}, {BD_LO, BD_LO, BD_FL}}, // 3
+	{{BD_FL, BD_LO, BD_FL}, {BD_BL, BD_BL, BD_FL}}, // 4
+	{{BD_FL, BD_UL, BD_UL}, {BD_LO, BD_LO, BD_FL}}, // 5
+	{{BD_FL, BD_UL, BD_UL}, {BD_FL, BD_LO, BD_FL}}, // 6
+	{{BD_UP, BD_UP, BD_FL}, {BD_BL, BD_BL, BD_FL}}, // 7
+	{{BD_FL, BD_UL, BD_FL}, {BD_FL, BD_LO, BD_FL}}, // 8
+	{{BD_FL, BD_UL, BD_FL}, {BD_LO, BD_LO, BD_FL}}, // 9
+};
+
+// Bar graphs resolution
+#define HBAR_STEPS 				5	// pixel columns in one cell
+#define VBAR_STEPS 				8	// pixel rows in one cell
+
+LCDGraphics::LCDGraphics(LCD1602 &lcd, uint8_t slots): lcd(lcd)
+{
+	this->slots_num = lcd.acquire_user_chars(slots, this->first_slot);
+}
+
+LCDGraphics::~LCDGraphics()
+{
+	lcd.release_user_chars(this->first_slot, this->slots_num);
+}
+
+void LCDGraphics::put(uint8_t row, uint8_t col, uint8_t code)
+{
+	cell c;
+	c.row = row;
+	c.col = col;
+	c.code = code;
+	c.glyph = NO_GLYPH;
+	this->cells.push_back(c);
+}
+
+void LCDGraphics::put_glyph(uint8_t row, uint8_t col, const bitmap &bm, uint8_t fallback)
+{
+	int16_t idx = 0;
+
+	// Same bitmaps share one glyph
+	for( ; idx < static_cast<int16_t>(this->glyphs.size()); ++idx){
+		if(this->glyphs[idx].bm == bm){
+			break;
+		}
+	}
+
+	if(idx == static_cast<int16_t>(this->glyphs.size())){
+		glyph g;
+		g.bm = bm;
+		g.fallback = fallback;
+		g.uses = 0;
+		g.slot = -1;
+		this->glyphs.push_back(g);
+	}
+
+	++this->glyphs[idx].uses;
+
+	cell c;
+	c.row = row;
+	c.col = col;
+	c.code = fallback;
+	c.glyph = idx;
+	this->cells.push_back(c);
+}
+
+void LCDGraphics::big_number(uint8_t top_row, uint8_t col, const std::string &str)
+{
+	for(char ch : str){
+
+		if(ch >= '0' && ch <= '9'){
+			const uint8_t (*digit)[BD_WIDTH] = bd_digits[ch - '0'];
+
+			for(uint8_t r = 0; r < 2; ++r){
+				for(uint8_t i = 0; i < BD_WIDTH; ++i){
+					uint8_t part = digit[r][i];
+
+					if(part == BD_BL){
+						this->put(top_row + r, col + i, SYMB_BLANK);
+					}
+					else if(part == BD_FL){
+						this->put(top_row + r, col + i, SYMB_FULL);
+					}
+					else{
+						this->put_glyph(top_row + r, col + i, bd_bitmaps[part], '-');
+					}
+				}
+			}
+			// Gap between digits
+			this->put(top_row, col + BD_WIDTH, SYMB_BLANK);
+			this->put(top_row + 1, col + BD_WIDTH, SYMB_BLANK);
+			col += BD_WIDTH + 1;
+		}
+		else if(ch == '-'){
+			for(uint8_t i = 0; i < BD_WIDTH; ++i){
+				this->put_glyph(top_row, col + i, bd_bitmaps[BD_LO], '-');
+				this->put(top_row + 1, col + i, SYMB_BLANK);
+			}
+			col += BD_WIDTH;
+		}
+		else if(ch == '.'){
+			this->put(top_row, col, SYMB_BLANK);
+			this->put(top_row + 1, col, '.');
+			col += 1;
+		}
+		else{
+			this->put(top_row, col, SYMB_BLANK);
+			this->put(top_row + 1, col, SYMB_BLANK);
+			col += 1;
+		}
+	}
+}
+
+// Number of filled steps from value / max
+static unsigned bar_steps(unsigned value, unsigned max, unsigned total)
+{
+	if(max == 0){
+		return 0;
+	}
+
+	if(value > max){
+		value = max;
+	}
+
+	return static_cast<unsigned>((static_cast<unsigned long long>(value) * total + max / 2) / max);
+}
+
+void LCDGraphics::hbar(uint8_t row, uint8_t col, uint8_t width, unsigned value, unsigned max)
+{
+	unsigned filled = bar_steps(value, max, width * HBAR_STEPS);
+
+	for(uint8_t i = 0; i < width; ++i){
+
+		if(filled >= HBAR_STEPS){
+			this->put(row, col + i, SYMB_FULL);
+			filled -= HBAR_STEPS;
+		}
+		else if(filled == 0){
+			this->put(row, col + i, SYMB_BLANK);
+		}
+		else{
+			// Left 'filled' pixel columns
+			uint8_t line = (0x1F << (HBAR_STEPS - filled)) & 0x1F;
+			bitmap bm;
+			bm.fill(line);
+			this->put_glyph(row, col + i, bm, (filled * 2 >= HBAR_STEPS) ? SYMB_FULL : SYMB_BLANK);
+			filled = 0;
+		}
+	}
+}
+
+void LCDGraphics::vbar(uint8_t bottom_row, uint8_t col, uint8_t height, unsigned value, unsigned max)
+{
+	unsigned filled = bar_steps(value, max, height * VBAR_STEPS);
+
+	for(uint8_t i = 0; i < height && i <= bottom_row; ++i){
+		uint8_t row = bottom_row - i;
+
+		if(filled >= VBAR_STEPS){
+			this->put(row, col, SYMB_FULL);
+			filled -= VBAR_STEPS;
+		}
+		else if(filled == 0){
+			this->put(row, col, SYMB_BLANK);
+		}
+		else{
+			// Bottom 'filled' pixel rows
+			bitmap bm;
+			for(unsigned r = 0; r < VBAR_STEPS; ++r){
+				bm[r] = (r >= VBAR_STEPS - filled) ? 0x1F : 0x00;
+			}
+			this->put_glyph(row, col, bm, (filled * 2 >= VBAR_STEPS) ? SYMB_FULL : SYMB_BLANK);
+			filled = 0;
+		}
+	}
+}
+
+// Fits frame glyphs into reserved CGRAM locations.
+// Glyphs already stored in CGRAM keep their locations, so only new bitmaps are uploaded.
+void LCDGraphics::plan()
+{
+	// Most used glyphs get locations first
+	std::vector<size_t> order(this->glyphs.size());
+	for(size_t i = 0; i < order.size(); ++i){
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b){
+		return this->glyphs[a].uses > this->glyphs[b].uses;
+	});
+
+	if(order.size() > this->slots_num){
+		order.resize(this->slots_num);
+	}
+
+	uint8_t busy_mask = 0;
+
+	// Reuse resident bitmaps
+	for(size_t idx : order){
+		glyph &g = this->glyphs[idx];
+
+		for(uint8_t s = 0; s < this->slots_num; ++s){
+			if( (this->resident_mask & (1 << s)) && !(busy_mask & (1 << s)) && this->resident[s] == g.bm ){
+				g.slot = s;
+				busy_mask |= (1 << s);
+				break;
+			}
+		}
+	}
+
+	// Upload new bitmaps to the free locations
+	for(size_t idx : order){
+		glyph &g = this->glyphs[idx];
+
+		if(g.slot >= 0){
+			continue;
+		}
+
+		for(uint8_t s = 0; s < this->slots_num; ++s){
+			if( !(busy_mask & (1 << s)) ){
+				this->lcd.user_char_create(this->first_slot + s, g.bm.data());
+				this->resident[s] = g.bm;
+				this->resident_mask |= (1 << s);
+				g.slot = s;
+				busy_mask |= (1 << s);
+				break;
+			}
+		}
+	}
+}
+
+void LCDGraphics::render()
+{
+	if(this->cells.empty()){
+		this->glyphs.clear();
+		return;
+	}
+
+	uint8_t row = this->lcd.get_current_row();
+	uint8_t col = this->lcd.get_current_col();
+
+	// CGRAM must be updated before DDRAM writes that use it
+	this->plan();
+
+	// Print cells row by row. The latest cell wins if the same position was used twice.
+	std::stable_sort(this->cells.begin(), this->cells.end(), [](const cell &a, const cell &b){
+		return (a.row != b.row) ? (a.row < b.row) : (a.col < b.col);
+	});
+
+	bool positioned = false;
+
+	for(size_t i = 0; i < this->cells.size(); ++i){
+		const cell &c = this->cells[i];
+
+		if( (i + 1 < this->cells.size()) && (this->cells[i + 1].row == c.row) && (this->cells[i + 1].col == c.col) ){
+			continue;
+		}
+
+		if( !positioned || (this->lcd.get_current_row() != c.row) || (this->lcd.get_current_col() != c.col) ){
+			this->lcd.set_cursor(c.row, c.col);
+			positioned = true;
+		}
+
+		uint8_t code = c.code;
+		if(c.glyph != NO_GLYPH && this->glyphs[c.glyph].slot >= 0){
+			code = this->first_slot + this->glyphs[c.glyph].slot;
+		}
+
+		this->lcd.user_char_print(code);
+	}
+
+	this->lcd.set_cursor(row, col);
+
+	this->cells.clear();
+	this->glyphs.clear();
+}
@@ -0,0 +1,93 @@
+//
+// -- Description:
+// Big digits and bar graphs renderer for HD44780-based LCDs
+//
+// -- Features:
+// 1. 2-row large numerals (3 cells wide + 1 cell gap)
+// 2. Horizontal bar graphs with 5-step sub-cell resolution (1 step = 1 pixel column)
+// 3. Vertical bar graphs with 8-step sub-cell resolution (1 step = 1 pixel row)
+// 4. Shared glyph set planning: glyphs of the whole frame are fitted into reserved
+//    CGRAM locations, only changed bitmaps are uploaded to the LCD.
+//
+// Renderer takes top free CGRAM locations with LCD1602::acquire_user_chars(), so software
+// generated Cyrillic symbols (print_ru) keep working with the remaining locations.
+// When the frame needs more glyphs than reserved locations, the least used ones are
+// replaced with the nearest ROM symbols (' ' or full block).
+//
+
+#ifndef _LCD_GRAPHICS_HPP
+#define _LCD_GRAPHICS_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+
+#include "lcd1602.hpp"
+
+class LCDGraphics
+{
+public:
+	typedef std::array<uint8_t, 8> bitmap;
+
+	LCDGraphics(LCD1602 &lcd, uint8_t slots = 4);
+	~LCDGraphics();
+
+	LCDGraphics(const LCDGraphics&) = delete;
+	LCDGraphics& operator=(const LCDGraphics&) = delete;
+
+	// Frame composition methods. Nothing is sent to LCD until render() call.
+
+	// Large number (supported symbols: '0'-'9', ' ', '-', '.') at rows top_row, top_row + 1
+	void big_number(uint8_t top_row, uint8_t col, const std::string &str);
+	// Horizontal bar of width cells from (row, col), filled according to value / max
+	void hbar(uint8_t row, uint8_t col, uint8_t width, unsigned value, unsigned max);
+	// Vertical bar of height cells from bottom_row up, filled according to value / max
+	void vbar(uint8_t bottom_row, uint8_t col, uint8_t height, unsigned value, unsigned max);
+	// Single ROM symbol (e.g. label between widgets)
+	void put(uint8_t row, uint8_t col, uint8_t code);
+
+	// Plans glyph set, uploads changed bitmaps and prints the frame.
+	// Cursor position is restored after rendering.
+	void render();
+
+	// Forget uploaded bitmaps (must be called after LCD1602::init())
+	void invalidate() { resident_mask = 0; }
+
+	uint8_t get_slots() const { return slots_num; }
+
+private:
+	static const int16_t NO_GLYPH = -1;
+
+	struct cell
+	{
+		uint8_t row;
+		uint8_t col;
+		uint8_t code;		// ROM symbol code (if no glyph)
+		int16_t glyph;		// index in glyphs or NO_GLYPH
+	};
+
+	struct glyph
+	{
+		bitmap bm;
+		uint8_t fallback;	// ROM symbol used when glyph doesn't fit reserved locations
+		unsigned uses;
+		int8_t slot;
+	};
+
+	LCD1602 &lcd;
+	uint8_t first_slot = 0;
+	uint8_t slots_num = 0;
+
+	std::vector<cell> cells;
+	std::vector<glyph> glyphs;
+
+	// Bitmaps currently stored in reserved CGRAM locations
+	std::array<bitmap, 8> resident;
+	uint8_t resident_mask = 0;
+
+	void put_glyph(uint8_t row, uint8_t col, const bitmap &bm, uint8_t fallback);
+	void plan();
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include <chrono>
+#include <exception>
+
+#include "i2c.hpp"
+#include "lcd_health.hpp"
+
+// Breaker state polling period (probes themselves are paced by the breaker backoff)
+#define CHECK_PERIOD_MS 		20
+
+LCDHealthMonitor::LCDHealthMonitor(unsigned failures_threshold, unsigned min_backoff_ms, unsigned max_backoff_ms)
+{
+	hw::i2c_set_breaker(failures_threshold, min_backoff_ms, max_backoff_ms);
+}
+
+LCDHealthMonitor::~LCDHealthMonitor()
+{
+	this->stop();
+	hw::i2c_set_breaker(0);
+}
+
+void LCDHealthMonitor::add(LCD1602 &lcd, std::mutex &lcd_mutex, callback on_recovered)
+{
+	display d;
+	d.lcd = &lcd;
+	d.lcd_mutex = &lcd_mutex;
+	d.on_recovered = on_recovered;
+	d.group = nullptr;
+	d.member = 0;
+	this->displays.push_back(d);
+}
+
+void LCDHealthMonitor::add(LCDMirror &group, std::mutex &lcd_mutex, callback on_recovered)
+{
+	for(size_t i = 0; i < group.size(); ++i){
+		display d;
+		d.lcd = &group;
+		d.lcd_mutex = &lcd_mutex;
+		d.on_recovered = on_recovered;
+		d.group = &group;
+		d.member = i;
+		this->displays.push_back(d);
+	}
+}
+
+void LCDHealthMonitor::start()
+{
+	std::lock_guard<std::mutex> lck(this->stop_mutex);
+
+	if(this->running){
+		return;
+	}
+
+	this->running = true;
+	this->worker = std::thread(&LCDHealthMonitor::run, this);
+}
+
+void LCDHealthMonitor::stop()
+{
+	{
+		std::lock_guard<std::mutex> lck(this->stop_mutex);
+		this->running = false;
+	}
+
+	this->stop_cv.notify_all();
+
+	if(this->worker.joinable()){
+		this->worker.join();
+	}
+}
+
+LCDHealthMonitor::statistics LCDHealthMonitor::get_statistics()
+{
+	std::lock_guard<std::mutex> lck(this->stats_mutex);
+	return this->stats;
+}
+
+void LCDHealthMonitor::check(display &d)
+{
+	uint8_t addr = d.group ? d.group->member_addr(d.member) : d.lcd->get_addr();
+
+	if( !hw::i2c_get_health(addr).probe_due ){
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lck(this->stats_mutex);
+		++this->stats.probes;
+	}
+
+	// Expander outputs are only changed to the idle state (EN low)
+	uint8_t idle = d.lcd->get_backlight_state() ? LCD_BACKLIGHT : LCD_NOBACKLIGHT;
+	if( !hw::i2c_probe(addr, idle) ){
+		return;
+	}
+
+	// Display is back, but its controller may have lost power
+	std::lock_guard<std::mutex> lcd_lck(*d.lcd_mutex);
+
+	try{
+		if(d.group){
+			d.group->rejoin(d.member);
+		}
+		else{
+			d.lcd->recover();
+		}
+
+		if(d.on_recovered){
+			d.on_recovered(*d.lcd);
+		}
+
+		std::lock_guard<std::mutex> lck(this->stats_mutex);
+		++this->stats.recoveries;
+	}
+	catch(const std::exception &){
+		std::lock_guard<std::mutex> lck(this->stats_mutex);
+		++this->stats.errors;
+	}
+}
+
+void LCDHealthMonitor::run()
+{
+	std::unique_lock<std::mutex> stop_lck(this->stop_mutex);
+
+	while(this->running){
+		stop_lck.unlock();
+
+		for(display &d : this->displays){
+			this->check(d);
+		}
+
+		stop_lck.lock();
+		this->stop_cv.wait_for(stop_lck, std::chrono::milliseconds(CHECK_PERIOD_MS), [this]{ return !this->running; });
+	}
+}
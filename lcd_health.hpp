@@ -0,0 +1,86 @@
+//
+// -- Description:
+// Health monitor for LCDs that may disappear from the bus (unplugged or dead panels)
+//
+// -- Features:
+// 1. Enables bus circuit breaker: after several consecutive errors writes to the display
+//    fail immediately, so it doesn't hold the bus for adapter timeouts
+// 2. Background probing of failed displays with exponential backoff
+// 3. Automatic controller reinitialization and repaint (LCD1602::recover()) when
+//    the display is back, then optional application callback for a full redraw
+// 4. Every member of LCDMirror is probed by its own address and returned to the group
+//    after reinitialization (LCDMirror::rejoin())
+//
+// Application must hold lcd_mutex while calling LCD1602 methods. Per-address statistics
+// (NACKs, timeouts, latency) are available with hw::i2c_get_health().
+//
+
+#ifndef _LCD_HEALTH_HPP
+#define _LCD_HEALTH_HPP
+
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+#include "lcd1602.hpp"
+#include "lcd_mirror.hpp"
+
+class LCDHealthMonitor
+{
+public:
+	typedef std::function<void(LCD1602&)> callback;
+
+	struct statistics
+	{
+		uint64_t probes = 0;		// probes of failed displays
+		uint64_t recoveries = 0;	// displays reinitialized after coming back
+		uint64_t errors = 0;		// failed recoveries
+	};
+
+	// Circuit breaker parameters (see hw::i2c_set_breaker())
+	explicit LCDHealthMonitor(unsigned failures_threshold = 3, unsigned min_backoff_ms = 100,
+		unsigned max_backoff_ms = 10000);
+	// Stops probing and disables the circuit breaker
+	~LCDHealthMonitor();
+
+	LCDHealthMonitor(const LCDHealthMonitor&) = delete;
+	LCDHealthMonitor& operator=(const LCDHealthMonitor&) = delete;
+
+	// Displays must be added before start(). on_recovered is called with lcd_mutex held.
+	void add(LCD1602 &lcd, std::mutex &lcd_mutex, callback on_recovered = nullptr);
+	// Members are checked separately, on_recovered is called with the group
+	void add(LCDMirror &group, std::mutex &lcd_mutex, callback on_recovered = nullptr);
+
+	void start();
+	void stop();
+
+	statistics get_statistics();
+
+private:
+	struct display
+	{
+		LCD1602 *lcd;
+		std::mutex *lcd_mutex;
+		callback on_recovered;
+		LCDMirror *group;			// lcd is a member of the group (nullptr - single display)
+		size_t member;
+	};
+
+	std::vector<display> displays;
+
+	std::thread worker;
+	std::mutex stop_mutex;
+	std::condition_variable stop_cv;
+	bool running = false;
+
+	std::mutex stats_mutex;
+	statistics stats;
+
+	void run();
+	void check(display &d);
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "lcd_layout.hpp"
+#include "trace.hpp"
+
+#define SYMB_SPACE 				' '
+#define SYMB_UNKNOWN 			'?'
+
+LCDLayout::LCDLayout(LCD1602 &lcd, unsigned dwell_ms): lcd(lcd)
+{
+	this->set_dwell(dwell_ms);
+	this->started = clock::now();
+}
+
+void LCDLayout::set_dwell(unsigned dwell_ms)
+{
+	if(dwell_ms == 0){
+		throw std::runtime_error("LCDLayout: invalid dwell time");
+	}
+
+	this->dwell = std::chrono::milliseconds(dwell_ms);
+}
+
+void LCDLayout::set_text(const std::string &utf8, LCD1602::Alignment align_type)
+{
+	if(align_type == LCD1602::Alignment::NO){
+		align_type = LCD1602::Alignment::LEFT;
+	}
+
+	LCDCharset::Rom rom = this->lcd.get_charset();
+	uint8_t rows = this->lcd.get_num_rows();
+	uint8_t cols = this->lcd.get_num_cols();
+
+	if( !this->pages.empty() && utf8 == this->text && align_type == this->align_type &&
+		rom == this->rom && rows == this->rows && cols == this->cols ){
+		return;
+	}
+
+	this->text = utf8;
+	this->align_type = align_type;
+	this->rom = rom;
+	this->rows = rows;
+	this->cols = cols;
+
+	this->layout();
+
+	this->page = 0;
+	this->shown = NO_PAGE;
+	this->started = clock::now();
+}
+
+// Same conversion as LCD1602::print_wc()
+LCDLayout::symbol LCDLayout::convert(const LCDCharset &cs, uint32_t cp) const
+{
+	symbol s;
+	s.wc = static_cast<wchar_t>(cp);
+	s.width = 1;
+
+	uint16_t entry = cs.lookup(cp);
+	uint16_t value = LCDCharset::value_of(entry);
+
+	switch(LCDCharset::kind_of(entry)){
+		case LCDCharset::ROM:
+			s.codes[0] = static_cast<uint8_t>(value);
+			break;
+
+		case LCDCharset::GLYPH:
+			s.width = 0;
+			break;
+
+		case LCDCharset::TRANSLIT:
+			s.width = 0;
+			for(const char *codes = cs.translit(value); *codes && s.width < sizeof(s.codes); ++codes){
+				s.codes[s.width++] = static_cast<uint8_t>(*codes);
+			}
+			if(s.width == 0){
+				s.codes[s.width++] = SYMB_UNKNOWN;
+			}
+			break;
+
+		default:
+			s.codes[0] = SYMB_UNKNOWN;
+	}
+
+	return s;
+}
+
+// Greedy word wrap. Runs of spaces are collapsed, words longer than the row are split
+// between symbols (transliterations are never split).
+void LCDLayout::layout()
+{
+	TRACE_SPAN("LCDLayout::layout", "lcd");
+
+	const LCDCharset &cs = LCDCharset::get(this->rom);
+	const size_t cols = this->cols;
+
+	std::vector<std::vector<symbol>> text_lines;
+	std::vector<symbol> line, word;
+	size_t line_width = 0, word_width = 0;
+
+	auto cells = [](const symbol &s) -> size_t { return s.width ? s.width : 1; };
+
+	auto new_line = [&](){
+		text_lines.push_back(line);
+		line.clear();
+		line_width = 0;
+	};
+
+	auto flush_word = [&](){
+		if(word.empty()){
+			return;
+		}
+
+		size_t sep = line.empty() ? 0 : 1;
+
+		if(line_width + sep + word_width <= cols){
+			if(sep){
+				line.push_back(this->convert(cs, SYMB_SPACE));
+				++line_width;
+			}
+		}
+		else if( !line.empty() ){
+			new_line();
+		}
+
+		for(const symbol &s : word){
+			if(line_width + cells(s) > cols){
+				new_line();
+			}
+			line.push_back(s);
+			line_width += cells(s);
+		}
+
+		word.clear();
+		word_width = 0;
+	};
+
+	const char *str = this->text.c_str();
+
+	while(*str){
+		uint32_t cp = LCDCharset::utf8_decode(str);
+
+		if(cp == ' ' || cp == '\t'){
+			flush_word();
+		}
+		else if(cp == '\n'){
+			flush_word();
+			new_line();
+		}
+		else if(cp != '\r'){
+			word.push_back(this->convert(cs, cp));
+			word_width += cells(word.back());
+		}
+	}
+
+	flush_word();
+	if( !line.empty() || text_lines.empty() ){
+		new_line();
+	}
+
+	// Lines to pages
+	this->lines = text_lines.size();
+	this->pages.assign((text_lines.size() + this->rows - 1) / this->rows, page_codes());
+
+	for(size_t i = 0; i < text_lines.size(); ++i){
+		page_codes &p = this->pages[i / this->rows];
+		if(p.codes.empty()){
+			p.codes.assign(this->rows * cols, SYMB_SPACE);
+		}
+
+		size_t width = 0;
+		for(const symbol &s : text_lines[i]){
+			width += cells(s);
+		}
+
+		size_t shift = 0;
+		if(this->align_type == LCD1602::Alignment::RIGHT){
+			shift = cols - width;
+		}
+		else if(this->align_type == LCD1602::Alignment::CENTER){
+			shift = (cols - width) / 2;
+		}
+
+		size_t cell = (i % this->rows) * cols + shift;
+
+		for(const symbol &s : text_lines[i]){
+			if(s.width == 0){
+				p.glyphs.emplace_back(static_cast<uint16_t>(cell++), s.wc);
+				continue;
+			}
+			memcpy(&p.codes[cell], s.codes, s.width);
+			cell += s.width;
+		}
+	}
+}
+
+void LCDLayout::draw(size_t page)
+{
+	const page_codes &p = this->pages[page];
+	auto glyph = p.glyphs.begin();
+
+	// Unchanged cells are not sent
+	this->lcd.begin_frame();
+
+	for(size_t row = 0; row < this->rows; ++row){
+		size_t cell = row * this->cols;
+		size_t end = cell + this->cols;
+
+		this->lcd.set_cursor(row, 0);
+
+		while(cell < end){
+			size_t run_end = (glyph != p.glyphs.end() && glyph->first < end) ? glyph->first : end;
+
+			this->lcd.print_codes(&p.codes[cell], run_end - cell);
+			cell = run_end;
+
+			if(cell < end){
+				this->lcd.print_ru(glyph->second);
+				++glyph;
+				++cell;
+			}
+		}
+	}
+
+	this->lcd.commit_frame();
+
+	this->page = page;
+	this->shown = page;
+}
+
+void LCDLayout::show(size_t page)
+{
+	TRACE_SPAN("LCDLayout::show", "lcd");
+
+	if(page >= this->pages.size()){
+		throw std::runtime_error("LCDLayout: invalid page number");
+	}
+
+	this->draw(page);
+
+	// Paging continues from the shown page
+	this->started = clock::now() - page * this->dwell;
+}
+
+LCDLayout::clock::duration LCDLayout::tick()
+{
+	TRACE_SPAN("LCDLayout::tick", "lcd");
+
+	if(this->pages.empty()){
+		return clock::duration::max();
+	}
+
+	if(this->pages.size() == 1){
+		if(this->shown != 0){
+			this->draw(0);
+		}
+		return clock::duration::max();
+	}
+
+	clock::time_point now = clock::now();
+	auto periods = (now - this->started) / this->dwell;
+	size_t due = static_cast<size_t>(periods) % this->pages.size();
+
+	if(this->shown != due){
+		this->draw(due);
+	}
+
+	return this->started + (periods + 1) * this->dwell - now;
+}
@@ -0,0 +1,93 @@
+//
+// -- Description:
+// Text layout for messages longer than the screen: word wrap and paging
+//
+// -- Features:
+// 1. UTF-8 text is measured in display cells (transliterated symbols take several cells)
+// 2. Word wrap by spaces, hard line breaks by '\n', too long words are split
+// 3. Lines are aligned (LEFT, CENTER, RIGHT) and grouped into pages of num_rows lines
+// 4. Layout and character codes of every page are computed once in set_text(), showing
+//    a page costs only the transfer of its changed cells (frame transaction)
+// 5. Paging by time: every page is shown for the dwell time
+//
+// tick() is meant to be called from the application's update loop like LCDAnimator::tick().
+//
+
+#ifndef _LCD_LAYOUT_HPP
+#define _LCD_LAYOUT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <chrono>
+
+#include "lcd1602.hpp"
+
+class LCDLayout
+{
+public:
+	typedef std::chrono::steady_clock clock;
+
+	explicit LCDLayout(LCD1602 &lcd, unsigned dwell_ms = 3000);
+
+	// Lays the text out. Same text with the same parameters keeps the cached layout
+	// and the current page.
+	void set_text(const std::string &utf8, LCD1602::Alignment align_type = LCD1602::Alignment::LEFT);
+	// Time each page is shown
+	void set_dwell(unsigned dwell_ms);
+
+	// Shows the due page if it is not on the screen yet. Returns time until the next page
+	// (clock::duration::max() for single page text).
+	clock::duration tick();
+	// Shows the page now, paging continues from it
+	void show(size_t page);
+
+	// Forget shown page (must be called after LCD1602::init() or other output)
+	void invalidate() { shown = NO_PAGE; }
+
+	size_t get_pages() const { return pages.size(); }
+	size_t get_page() const { return page; }
+	size_t get_lines() const { return lines; }
+
+private:
+	static const size_t NO_PAGE = static_cast<size_t>(-1);
+
+	// Page contents: num_rows * num_cols character codes, symbols without ROM codes
+	// (software generated ones) are kept by cell index and printed with print_ru()
+	struct page_codes
+	{
+		std::vector<uint8_t> codes;
+		std::vector<std::pair<uint16_t, wchar_t>> glyphs;
+	};
+
+	// One code point converted to the display cells
+	struct symbol
+	{
+		wchar_t wc;
+		uint8_t codes[8];
+		uint8_t width;		// 0 - printed by print_ru() (one cell)
+	};
+
+	LCD1602 &lcd;
+	clock::duration dwell;
+	clock::time_point started;
+
+	// Cache key
+	std::string text;
+	LCD1602::Alignment align_type = LCD1602::Alignment::LEFT;
+	LCDCharset::Rom rom = LCDCharset::Rom::A00;
+	uint8_t rows = 0;
+	uint8_t cols = 0;
+
+	std::vector<page_codes> pages;
+	size_t lines = 0;
+	size_t page = 0;
+	size_t shown = NO_PAGE;
+
+	symbol convert(const LCDCharset &cs, uint32_t cp) const;
+	void layout();
+	void draw(size_t page);
+};
+
+#endif
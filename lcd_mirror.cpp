@@ -0,0 +1,78 @@
+#include <stdexcept>
+
+#include "i2c.hpp"
+#include "lcd_mirror.hpp"
+
+LCDMirror::LCDMirror(const std::vector<uint8_t> &addrs): 
+	LCD1602(addrs.empty() ? PCF8574A_ADDR : addrs[0]), addrs(addrs)
+{
+	if(addrs.empty()){
+		throw std::runtime_error("LCDMirror: no member addresses");
+	}
+
+	for(uint8_t addr : addrs){
+		this->members.emplace_back(addr);
+	}
+
+	this->touched.assign(addrs.size(), false);
+	this->dropped.assign(addrs.size(), false);
+}
+
+void LCDMirror::init(const std::string &i2c_dev)
+{
+	LCD1602::init(this->addrs[0], i2c_dev);
+}
+
+LCD1602& LCDMirror::member(size_t idx)
+{
+	LCD1602 &lcd = this->members.at(idx);
+
+	// Display has received the same traffic as the group since the last access
+	if( !this->touched[idx] ){
+		lcd.copy_state(*this);
+		this->touched[idx] = true;
+	}
+
+	this->diverged = true;
+
+	return lcd;
+}
+
+void LCDMirror::rejoin(size_t idx)
+{
+	LCD1602 &lcd = this->members.at(idx);
+
+	// Controller may have lost power: recover() initializes it and restores the model
+	lcd.copy_state(*this);
+	lcd.recover();
+
+	this->touched[idx] = false;
+	this->dropped[idx] = false;
+}
+
+void LCDMirror::write_expander(const uint8_t *buf, uint16_t len)
+{
+	// Group model doesn't match diverged members anymore: commands are sent
+	// unconditionally from now on (until init())
+	if(this->diverged){
+		this->invalidate_state();
+		this->touched.assign(this->touched.size(), false);
+		this->diverged = false;
+	}
+
+	this->active.clear();
+	for(size_t i = 0; i < this->addrs.size(); ++i){
+		if( !this->dropped[i] && hw::i2c_get_health(this->addrs[i]).open ){
+			this->dropped[i] = true;
+		}
+		if( !this->dropped[i] ){
+			this->active.push_back(this->addrs[i]);
+		}
+	}
+
+	if(this->active.empty()){
+		throw std::runtime_error("LCDMirror: all members are dropped");
+	}
+
+	hw::i2c_write_multi(this->active.data(), this->active.size(), buf, len);
+}
@@ -0,0 +1,62 @@
+//
+// -- Description:
+// Mirrored output of identical content to several LCDs on the same bus
+//
+// -- Features:
+// 1. Frame is encoded once (one LCD1602 pipeline run) for all displays
+// 2. Expander bytes for all member addresses are packed into shared I2C_RDWR calls
+// 3. Each member keeps its own state model, so it can diverge later
+//
+// All LCD1602 methods of the group are applied to every member. Readback (verify_step)
+// checks the first member only, repaired cells are rewritten on all of them. Reads move
+// the address counter of the first member only, so it is set on all members after them.
+//
+// Member, that has stopped responding (its circuit breaker is open), is dropped from
+// group output: it may lose power and must be initialized before it gets commands again.
+// It is returned by rejoin(), LCDHealthMonitor::add(LCDMirror&, ...) does it automatically.
+//
+
+#ifndef _LCD_MIRROR_HPP
+#define _LCD_MIRROR_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "lcd1602.hpp"
+
+class LCDMirror final: public LCD1602
+{
+public:
+	explicit LCDMirror(const std::vector<uint8_t> &addrs);
+
+	// Initialize all members at once
+	void init(const std::string &i2c_dev = "");
+
+	size_t size() const { return members.size(); }
+
+	// Member display for individual output. Its state model is taken from the group
+	// if the member was not used individually since the last group output. After
+	// individual output the group stops eliding redundant commands until init().
+	LCD1602& member(size_t idx);
+
+	uint8_t member_addr(size_t idx) const { return addrs.at(idx); }
+	// Member is left out of group output: its circuit breaker was open (see hw::i2c_set_breaker)
+	bool is_dropped(size_t idx) const { return dropped.at(idx); }
+	// Initializes the member controller, repaints it from the group model and returns it
+	// to group output (LCDHealthMonitor calls it when the member is back)
+	void rejoin(size_t idx);
+
+protected:
+	void write_expander(const uint8_t *buf, uint16_t len) override;
+
+private:
+	std::vector<uint8_t> addrs;
+	std::vector<LCD1602> members;
+	std::vector<bool> touched;		// member was used individually since the last group output
+	std::vector<bool> dropped;		// member is not sent group output until rejoin()
+	std::vector<uint8_t> active;	// addresses of the members in group output
+	bool diverged = false;			// any member was used individually
+};
+
+#endif
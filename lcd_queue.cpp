@@ -0,0 +1,148 @@
+#include <exception>
+#include <chrono>
+
+#include "lcd_queue.hpp"
+
+// Renderer re-checks the ring at least this often (protection against lost wake-ups)
+#define IDLE_CHECK_MS 			10
+
+LCDQueue::LCDQueue(LCD1602 &lcd, size_t capacity): lcd(lcd)
+{
+	size_t size = 2;
+	while(size < capacity){
+		size <<= 1;
+	}
+
+	this->mask = size - 1;
+	this->ring.reset(new slot[size]);
+
+	for(size_t i = 0; i < size; ++i){
+		this->ring[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	this->renderer = std::thread(&LCDQueue::run, this);
+}
+
+LCDQueue::~LCDQueue()
+{
+	this->flush();
+	this->running = false;
+
+	{
+		std::lock_guard<std::mutex> lck(this->wake_mutex);
+		this->wake_cv.notify_one();
+	}
+
+	this->renderer.join();
+}
+
+// Bounded MPMC ring (D. Vyukov): each slot sequence tells whether it's free for the
+// producer with ticket 'pos' (seq == pos) or filled for the consumer (seq == pos + 1)
+bool LCDQueue::try_submit(operation op)
+{
+	size_t pos = this->tail.load(std::memory_order_relaxed);
+	slot *s;
+
+	for(;;){
+		s = &this->ring[pos & this->mask];
+		size_t seq = s->seq.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+		if(diff == 0){
+			if(this->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+				break;
+			}
+		}
+		else if(diff < 0){
+			return false;	// full
+		}
+		else{
+			pos = this->tail.load(std::memory_order_relaxed);
+		}
+	}
+
+	s->op = std::move(op);
+	s->seq.store(pos + 1, std::memory_order_release);
+
+	// Pairs with renderer's sleeping flag store followed by the ring check
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if(this->sleeping.load(std::memory_order_relaxed)){
+		std::lock_guard<std::mutex> lck(this->wake_mutex);
+		this->wake_cv.notify_one();
+	}
+
+	return true;
+}
+
+void LCDQueue::submit(operation op)
+{
+	while( !this->try_submit(op) ){
+		std::this_thread::yield();
+	}
+}
+
+bool LCDQueue::pop(operation &op)
+{
+	size_t pos = this->head.load(std::memory_order_relaxed);
+	slot &s = this->ring[pos & this->mask];
+
+	if(s.seq.load(std::memory_order_acquire) != pos + 1){
+		return false;	// empty
+	}
+
+	op = std::move(s.op);
+	s.op = nullptr;
+	s.seq.store(pos + this->mask + 1, std::memory_order_release);
+	this->head.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+void LCDQueue::flush()
+{
+	size_t target = this->tail.load(std::memory_order_acquire);
+
+	std::unique_lock<std::mutex> lck(this->wake_mutex);
+	this->done_cv.wait(lck, [this, target]{ 
+		return this->head.load(std::memory_order_acquire) >= target || !this->running; 
+	});
+}
+
+std::string LCDQueue::get_last_error()
+{
+	std::lock_guard<std::mutex> lck(this->error_mutex);
+	return this->last_error;
+}
+
+void LCDQueue::run()
+{
+	operation op;
+
+	while(this->running){
+		while(this->pop(op)){
+			try{
+				op(this->lcd);
+			}
+			catch(const std::exception &e){
+				++this->errors;
+				std::lock_guard<std::mutex> lck(this->error_mutex);
+				this->last_error = e.what();
+			}
+
+			op = nullptr;
+		}
+
+		std::unique_lock<std::mutex> lck(this->wake_mutex);
+		this->done_cv.notify_all();
+
+		this->sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		// Re-check after announcing sleep: producer could submit before seeing the flag
+		size_t pos = this->head.load(std::memory_order_relaxed);
+		if( this->running && (this->ring[pos & this->mask].seq.load(std::memory_order_acquire) != pos + 1) ){
+			this->wake_cv.wait_for(lck, std::chrono::milliseconds(IDLE_CHECK_MS));
+		}
+		this->sleeping.store(false, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,94 @@
+//
+// -- Description:
+// Thread-safe access to LCD1602 through a lock-free multi-producer submission ring
+//
+// -- Features:
+// 1. Any number of threads submit complete operations without locks and without
+//    waiting for the bus
+// 2. One renderer thread owns the display and applies operations one by one,
+//    so each operation appears atomically and in submission order
+// 3. flush() for producers, that need to know when their output reached the display
+//
+// The display must not be used directly while LCDQueue is running.
+//
+
+#ifndef _LCD_QUEUE_HPP
+#define _LCD_QUEUE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "lcd1602.hpp"
+
+class LCDQueue
+{
+public:
+	typedef std::function<void(LCD1602&)> operation;
+
+	// capacity is rounded up to the power of 2
+	explicit LCDQueue(LCD1602 &lcd, size_t capacity = 64);
+	~LCDQueue();
+
+	LCDQueue(const LCDQueue&) = delete;
+	LCDQueue& operator=(const LCDQueue&) = delete;
+
+	// Returns false if the ring is full
+	bool try_submit(operation op);
+	// Yields while the ring is full
+	void submit(operation op);
+
+	// Shortcuts for frequent operations
+	void print(uint8_t row, uint8_t col, const std::string &str) {
+		this->submit([row, col, str](LCD1602 &lcd){ lcd.set_cursor(row, col); lcd.print(str); });
+	}
+	void print_ru(uint8_t row, uint8_t col, const std::string &str) {
+		this->submit([row, col, str](LCD1602 &lcd){ lcd.set_cursor(row, col); lcd.print_ru(str); });
+	}
+	void clear() { this->submit([](LCD1602 &lcd){ lcd.clear(); }); }
+
+	// Waits until all operations submitted before the call are applied
+	void flush();
+
+	// Operations failed with exception
+	uint64_t get_errors() const { return errors; }
+	std::string get_last_error();
+
+private:
+	struct slot
+	{
+		std::atomic<size_t> seq;
+		operation op;
+	};
+
+	LCD1602 &lcd;
+	size_t mask;
+	std::unique_ptr<slot[]> ring;
+
+	// Producers and consumer positions on separate cache lines
+	alignas(64) std::atomic<size_t> tail { 0 };
+	alignas(64) std::atomic<size_t> head { 0 };			// written by renderer only
+
+	std::atomic<bool> running { true };
+	std::atomic<bool> sleeping { false };
+	std::mutex wake_mutex;
+	std::condition_variable wake_cv;		// renderer waits for operations
+	std::condition_variable done_cv;		// flush() waits for renderer
+
+	std::atomic<uint64_t> errors { 0 };
+	std::mutex error_mutex;
+	std::string last_error;
+
+	std::thread renderer;
+
+	bool pop(operation &op);
+	void run();
+};
+
+#endif
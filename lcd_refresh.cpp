@@ -0,0 +1,110 @@
+#include <chrono>
+#include <exception>
+
+extern "C"{
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+}
+
+#include "lcd_refresh.hpp"
+
+// Pause between steps bounds
+#define MIN_PAUSE_MS 			10
+#define ERROR_PAUSE_MS 			1000
+
+void LCDRefresher::set_duty_cycle(double duty)
+{
+	if(duty <= 0.0 || duty > 1.0){
+		duty = 1.0;
+	}
+
+	this->duty_cycle = duty;
+}
+
+void LCDRefresher::start()
+{
+	std::lock_guard<std::mutex> lck(this->stop_mutex);
+
+	if(this->running){
+		return;
+	}
+
+	this->running = true;
+	this->worker = std::thread(&LCDRefresher::run, this);
+}
+
+void LCDRefresher::stop()
+{
+	{
+		std::lock_guard<std::mutex> lck(this->stop_mutex);
+		this->running = false;
+	}
+
+	this->stop_cv.notify_all();
+
+	if(this->worker.joinable()){
+		this->worker.join();
+	}
+}
+
+LCDRefresher::statistics LCDRefresher::get_statistics()
+{
+	std::lock_guard<std::mutex> lck(this->stats_mutex);
+	return this->stats;
+}
+
+void LCDRefresher::run()
+{
+	// Low priority, but not SCHED_IDLE: the thread holds lcd_mutex during a step and
+	// must not be starved by busy threads while the application waits for the mutex
+	struct sched_param param = {};
+	pthread_setschedparam(pthread_self(), SCHED_BATCH, &param);
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+
+	std::unique_lock<std::mutex> stop_lck(this->stop_mutex);
+
+	while(this->running){
+		stop_lck.unlock();
+
+		std::chrono::milliseconds pause(MIN_PAUSE_MS);
+		std::unique_lock<std::mutex> lcd_lck(this->lcd_mutex, std::try_to_lock);
+
+		if( !lcd_lck.owns_lock() ){
+			std::lock_guard<std::mutex> lck(this->stats_mutex);
+			++this->stats.busy_skips;
+		}
+		else{
+			auto start = std::chrono::steady_clock::now();
+
+			try{
+				size_t repaired = this->lcd.verify_step(this->cells_per_step);
+
+				std::lock_guard<std::mutex> lck(this->stats_mutex);
+				++this->stats.steps;
+				this->stats.repaired += repaired;
+			}
+			catch(const std::exception &){
+				std::lock_guard<std::mutex> lck(this->stats_mutex);
+				++this->stats.errors;
+				pause = std::chrono::milliseconds(ERROR_PAUSE_MS);
+			}
+
+			lcd_lck.unlock();
+
+			// Step took 'busy' time, so idle for busy * (1 - duty) / duty
+			auto busy = std::chrono::steady_clock::now() - start;
+			double duty = this->duty_cycle;
+			auto idle = std::chrono::duration_cast<std::chrono::milliseconds>(busy * ((1.0 - duty) / duty));
+
+			if(idle > pause){
+				pause = idle;
+			}
+		}
+
+		stop_lck.lock();
+		this->stop_cv.wait_for(stop_lck, pause, [this]{ return !this->running; });
+	}
+}
@@ -0,0 +1,72 @@
+//
+// -- Description:
+// Self-healing background refresh for HD44780-based LCDs
+//
+// -- Features:
+// 1. Low-priority (SCHED_BATCH, nice 19) thread, that reads DDRAM / CGRAM back through PCF8574
+//    in small chunks and rewrites cells differing from the driver's model
+// 2. Controller reinitialization and repaint when it stops responding
+// 3. Bus usage bounded by configurable duty cycle
+//
+// Application must hold lcd_mutex while calling LCD1602 methods. Refresher only
+// tries to lock it, so foreground updates are never waiting for more than one step.
+//
+
+#ifndef _LCD_REFRESH_HPP
+#define _LCD_REFRESH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "lcd1602.hpp"
+
+class LCDRefresher
+{
+public:
+	struct statistics
+	{
+		uint64_t steps = 0;			// verification steps done
+		uint64_t repaired = 0;		// rewritten cells
+		uint64_t busy_skips = 0;	// steps skipped because LCD was used by application
+		uint64_t errors = 0;		// i2c errors
+	};
+
+	LCDRefresher(LCD1602 &lcd, std::mutex &lcd_mutex): lcd(lcd), lcd_mutex(lcd_mutex) {}
+	~LCDRefresher() { this->stop(); }
+
+	LCDRefresher(const LCDRefresher&) = delete;
+	LCDRefresher& operator=(const LCDRefresher&) = delete;
+
+	// Share of time the refresher may occupy the bus: (0.0 .. 1.0]
+	void set_duty_cycle(double duty);
+	// Number of cells checked in one step
+	void set_cells_per_step(size_t cells) { cells_per_step = cells ? cells : 1; }
+
+	void start();
+	void stop();
+
+	statistics get_statistics();
+
+private:
+	LCD1602 &lcd;
+	std::mutex &lcd_mutex;
+
+	std::atomic<double> duty_cycle { 0.02 };
+	std::atomic<size_t> cells_per_step { 4 };
+
+	std::thread worker;
+	std::mutex stop_mutex;
+	std::condition_variable stop_cv;
+	bool running = false;
+
+	std::mutex stats_mutex;
+	statistics stats;
+
+	void run();
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include <exception>
+
+#include "lcd_scheduler.hpp"
+
+LCDScheduler::LCDScheduler(LCD1602 &lcd, size_t max_queued): 
+	lcd(lcd), max_queued(max_queued ? max_queued : 1)
+{
+	this->worker = std::thread(&LCDScheduler::run, this);
+}
+
+LCDScheduler::~LCDScheduler()
+{
+	this->flush();
+
+	{
+		std::lock_guard<std::mutex> lck(this->mutex);
+		this->running = false;
+	}
+
+	this->cv.notify_one();
+	this->worker.join();
+}
+
+void LCDScheduler::set_drop_background_on_alert(bool on)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+	this->drop_background = on;
+}
+
+void LCDScheduler::submit(Priority prio, operation op, uint32_t key)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+
+	class_state &cls = this->classes[static_cast<size_t>(prio)];
+
+	// Newer content for the same region makes queued one useless
+	if(key){
+		for(auto &it : cls.queue){
+			if(it.key == key){
+				it.op = std::move(op);
+				++cls.coalesced;
+				return;
+			}
+		}
+	}
+
+	if(prio == Priority::ALERT){
+		class_state &bg = this->classes[static_cast<size_t>(Priority::BACKGROUND)];
+
+		if(this->drop_background && !bg.queue.empty()){
+			bg.dropped += bg.queue.size();
+			bg.queue.clear();
+		}
+	}
+	else if(cls.queue.size() >= this->max_queued){
+		// Alerts are never dropped
+		cls.queue.pop_front();
+		++cls.dropped;
+	}
+
+	item it;
+	it.op = std::move(op);
+	it.key = key;
+	it.submitted = clock::now();
+	cls.queue.push_back(std::move(it));
+
+	this->cv.notify_one();
+}
+
+void LCDScheduler::flush()
+{
+	std::unique_lock<std::mutex> lck(this->mutex);
+
+	this->idle_cv.wait(lck, [this]{
+		if(this->busy){
+			return false;
+		}
+		for(auto &cls : this->classes){
+			if( !cls.queue.empty() ){
+				return false;
+			}
+		}
+		return true;
+	});
+}
+
+// Called under mutex
+void LCDScheduler::account(class_state &cls, clock::time_point submitted)
+{
+	uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - submitted).count();
+
+	++cls.applied;
+	cls.latency_sum_us += us;
+
+	if(us > cls.max_latency_us){
+		cls.max_latency_us = us;
+	}
+
+	size_t bucket = 0;
+	while( (bucket < BUCKETS - 1) && (us >= (1ULL << bucket)) ){
+		++bucket;
+	}
+
+	++cls.histogram[bucket];
+}
+
+LCDScheduler::statistics LCDScheduler::get_statistics(Priority prio)
+{
+	std::lock_guard<std::mutex> lck(this->mutex);
+
+	const class_state &cls = this->classes[static_cast<size_t>(prio)];
+	statistics res;
+
+	res.applied = cls.applied;
+	res.coalesced = cls.coalesced;
+	res.dropped = cls.dropped;
+	res.errors = cls.errors;
+	res.max_latency_us = cls.max_latency_us;
+	res.avg_latency_us = cls.applied ? (cls.latency_sum_us / cls.applied) : 0;
+
+	uint64_t count = 0;
+	for(size_t b = 0; cls.applied && (b < BUCKETS); ++b){
+		count += cls.histogram[b];
+
+		if(count * 100 >= cls.applied * 99){
+			res.p99_latency_us = 1ULL << b;
+			break;
+		}
+	}
+
+	return res;
+}
+
+void LCDScheduler::run()
+{
+	std::unique_lock<std::mutex> lck(this->mutex);
+
+	for(;;){
+		// Highest priority class with queued work is served first
+		class_state *cls = nullptr;
+
+		for(auto &c : this->classes){
+			if( !c.queue.empty() ){
+				cls = &c;
+				break;
+			}
+		}
+
+		if( !cls ){
+			this->idle_cv.notify_all();
+
+			if( !this->running ){
+				return;
+			}
+
+			this->cv.wait(lck);
+			continue;
+		}
+
+		item it = std::move(cls->queue.front());
+		cls->queue.pop_front();
+		this->busy = true;
+
+		lck.unlock();
+
+		bool failed = false;
+
+		try{
+			it.op(this->lcd);
+		}
+		catch(const std::exception &){
+			failed = true;
+		}
+
+		lck.lock();
+
+		// Failed operation is also counted as applied: its latency is still meaningful
+		if(failed){
+			++cls->errors;
+		}
+
+		this->busy = false;
+		this->account(*cls, it.submitted);
+	}
+}
@@ -0,0 +1,112 @@
+//
+// -- Description:
+// Priority-aware scheduler of LCD1602 operations
+//
+// -- Features:
+// 1. Priority classes: alerts preempt routine updates at operation boundaries
+// 2. Coalescing: queued operation with the same key (e.g. screen region) is replaced
+// 3. Bounded queues: the oldest routine / background work is dropped on overflow,
+//    background work is dropped when an alert arrives (optional)
+// 4. Per-class submit-to-display latency statistics
+//
+// Long outputs should be split into several operations, so alerts don't wait for them.
+// The display must not be used directly while LCDScheduler is running.
+//
+
+#ifndef _LCD_SCHEDULER_HPP
+#define _LCD_SCHEDULER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#include "lcd1602.hpp"
+
+class LCDScheduler
+{
+public:
+	enum class Priority : char
+	{
+		ALERT = 0,
+		NORMAL,
+		BACKGROUND,
+	};
+
+	typedef std::function<void(LCD1602&)> operation;
+
+	struct statistics
+	{
+		uint64_t applied = 0;
+		uint64_t coalesced = 0;
+		uint64_t dropped = 0;
+		uint64_t errors = 0;			// operations failed with exception
+		uint64_t avg_latency_us = 0;
+		uint64_t max_latency_us = 0;
+		uint64_t p99_latency_us = 0;	// upper bound (power of 2 histogram)
+	};
+
+	explicit LCDScheduler(LCD1602 &lcd, size_t max_queued = 32);
+	~LCDScheduler();
+
+	LCDScheduler(const LCDScheduler&) = delete;
+	LCDScheduler& operator=(const LCDScheduler&) = delete;
+
+	// key != 0: replaces queued operation of the same class with the same key
+	void submit(Priority prio, operation op, uint32_t key = 0);
+
+	// Drop queued background work when an alert is submitted (default true)
+	void set_drop_background_on_alert(bool on);
+
+	// Waits until all queued operations are applied
+	void flush();
+
+	statistics get_statistics(Priority prio);
+
+private:
+	static const size_t CLASSES = 3;
+	static const size_t BUCKETS = 32;
+
+	typedef std::chrono::steady_clock clock;
+
+	struct item
+	{
+		operation op;
+		uint32_t key;
+		clock::time_point submitted;
+	};
+
+	struct class_state
+	{
+		std::deque<item> queue;
+		uint64_t applied = 0;
+		uint64_t coalesced = 0;
+		uint64_t dropped = 0;
+		uint64_t errors = 0;
+		uint64_t latency_sum_us = 0;
+		uint64_t max_latency_us = 0;
+		uint64_t histogram[BUCKETS] = {0};	// bucket n: latency < 2^n us
+	};
+
+	LCD1602 &lcd;
+	size_t max_queued;
+	bool drop_background = true;
+
+	std::mutex mutex;
+	std::condition_variable cv;			// new work or stop
+	std::condition_variable idle_cv;	// queues are empty
+	class_state classes[CLASSES];
+	bool busy = false;
+	bool running = true;
+
+	std::thread worker;
+
+	void run();
+	void account(class_state &cls, clock::time_point submitted);
+};
+
+#endif
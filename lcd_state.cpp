@@ -0,0 +1,111 @@
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+
+extern "C"{
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+#include "lcd_state.hpp"
+#include "trace.hpp"
+
+#ifndef LCD_STATE_DIR
+#define LCD_STATE_DIR 			"/run/lcd1602"
+#endif
+
+#define STATE_MAGIC 			0x5344434CU		// "LCDS"
+
+// errno is kept in the exception, so callers can tell "no access" from real failures
+static std::system_error sys_error(int err, const std::string &what)
+{
+	return std::system_error(err, std::generic_category(), what + " failed");
+}
+
+LCDStateFile::LCDStateFile(const std::string &i2c_dev, uint8_t lcd_addr)
+{
+	TRACE_SPAN("LCDStateFile::open", "lcd");
+
+	// Directory is shared with bus lock files of other users (see i2c_lock.cpp)
+	std::string path = state_path(i2c_dev, lcd_addr);
+	int dir_err = 0;
+	if(mkdir(LCD_STATE_DIR, 01777) == 0){
+		chmod(LCD_STATE_DIR, 01777);
+	}
+	else if(errno != EEXIST){
+		dir_err = errno;
+	}
+
+	this->fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(this->fd < 0){
+		// Missing directory which can't be created: report why
+		int err = (errno == ENOENT && dir_err) ? dir_err : errno;
+		throw sys_error(err, "open state file '" + path + "'");
+	}
+
+	while(flock(this->fd, LOCK_EX) < 0){
+		if(errno != EINTR){
+			int err = errno;
+			close(this->fd);
+			throw sys_error(err, "lock state file '" + path + "'");
+		}
+	}
+
+	// New file is zero-filled, so it has no valid state
+	struct stat st;
+	if(fstat(this->fd, &st) < 0 || (st.st_size != sizeof(record) && ftruncate(this->fd, sizeof(record)) < 0)){
+		int err = errno;
+		close(this->fd);
+		throw sys_error(err, "resize state file '" + path + "'");
+	}
+
+	void *mem = mmap(nullptr, sizeof(record), PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if(mem == MAP_FAILED){
+		int err = errno;
+		close(this->fd);
+		throw sys_error(err, "mmap state file '" + path + "'");
+	}
+
+	this->rec = static_cast<record*>(mem);
+}
+
+// Unlocked by close()
+LCDStateFile::~LCDStateFile()
+{
+	munmap(this->rec, sizeof(record));
+	close(this->fd);
+}
+
+bool LCDStateFile::load(LCD1602 &lcd)
+{
+	bool ok = (this->rec->magic == STATE_MAGIC) && (this->rec->size == sizeof(record)) &&
+		this->rec->valid && lcd.restore_state(this->rec->state);
+
+	this->rec->valid = 0;
+	return ok;
+}
+
+void LCDStateFile::store(const LCD1602 &lcd)
+{
+	lcd.save_state(this->rec->state);
+	this->rec->magic = STATE_MAGIC;
+	this->rec->size = sizeof(record);
+	this->rec->valid = 1;
+}
+
+std::string LCDStateFile::state_path(const std::string &i2c_dev, uint8_t lcd_addr)
+{
+	char addr[8];
+	snprintf(addr, sizeof(addr), "%02x", lcd_addr);
+
+	// /dev/i2c-0 -> i2c-0
+	size_t pos = i2c_dev.rfind('/');
+	std::string dev_name = (pos == std::string::npos) ? i2c_dev : i2c_dev.substr(pos + 1);
+
+	return std::string(LCD_STATE_DIR) + "/" + dev_name + "-" + addr + ".state";
+}
@@ -0,0 +1,59 @@
+//
+// -- Description:
+// Driver state persisted between processes (e.g. consecutive lcd_util calls)
+//
+// -- Features:
+// 1. One small mmap-ed file per display: LCD_STATE_DIR/<i2c-dev>-<addr>.state (/run/lcd1602 by default)
+// 2. Exclusive lock (flock) for the object lifetime: processes using the same display are serialized
+// 3. State is marked invalid while the display is used, so a process killed in the middle of
+//    a command leaves no stale model (next process starts with unknown controller state)
+//
+// /run is cleared on reboot together with the displays powered from the host.
+// Displays power-cycled separately need init() anyway, which resets the saved model.
+//
+
+#ifndef _LCD_STATE_HPP
+#define _LCD_STATE_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "lcd1602.hpp"
+
+class LCDStateFile
+{
+public:
+	// Opens (creates) and locks the state file of the display. Waits if it's locked by another process.
+	// Throws std::system_error (errno code) if the file can't be opened or mapped.
+	LCDStateFile(const std::string &i2c_dev, uint8_t lcd_addr);
+	~LCDStateFile();
+
+	LCDStateFile(const LCDStateFile&) = delete;
+	LCDStateFile& operator=(const LCDStateFile&) = delete;
+
+	// Restores saved state into lcd and marks it invalid until store().
+	// Returns false if there is no valid state.
+	bool load(LCD1602 &lcd);
+	// Saves state of lcd after successfully completed commands
+	void store(const LCD1602 &lcd);
+	// Display was changed behind the driver (e.g. replayed traffic)
+	void invalidate() { rec->valid = 0; }
+	// File holds a valid state (e.g. stored by another process after load())
+	bool is_valid() const { return rec->valid != 0; }
+
+	static std::string state_path(const std::string &i2c_dev, uint8_t lcd_addr);
+
+private:
+	struct record
+	{
+		uint32_t magic;
+		uint32_t size;
+		uint32_t valid;
+		LCD1602::saved_state state;
+	};
+
+	int fd = -1;
+	record *rec = nullptr;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include <cstring>
+#include <cerrno>
+
+extern "C"{
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+}
+
+#include "lcd_tiny.hpp"
+#include "lcd_encode.hpp"
+
+// PCF8574 pins (see lcd1602.cpp)
+#define PIN_RS 		( (uint8_t)(1 << 0) )
+#define PIN_EN 		( (uint8_t)(1 << 2) )
+
+// Commands
+#define LCD_CLEARDISPLAY 		0x01
+#define LCD_RETURNHOME 			0x02
+#define LCD_ENTRYMODESET 		0x04
+#define LCD_DISPLAYCONTROL 		0x08
+#define LCD_FUNCTIONSET 		0x20
+#define LCD_SETCGRAMADDR 		0x40
+#define LCD_SETDDRAMADDR 		0x80
+
+#define LCD_ENTRYLEFT 			0x02
+#define LCD_DISPLAYON 			0x04
+#define LCD_CURSORON 			0x02
+#define LCD_BLINKON 			0x01
+#define LCD_2LINE 				0x08
+
+// Datasheet worst case delays (us)
+#define DELAY_COMMAND 			50
+#define DELAY_CLEAR 			2000
+#define DELAY_INIT_LONG 		4500
+#define DELAY_INIT_SHORT 		150
+
+// Data bytes per transaction (expander stream is 4 times longer)
+#define RUN_MAX_BYTES 			16
+
+#define NUM_COLS 				16
+#define NSEC_PER_SEC 			1000000000L
+
+int LCDTiny::open(const char *i2c_dev)
+{
+	this->close();
+
+	if(i2c_dev == nullptr){
+		this->mock = true;
+		return 0;
+	}
+
+	this->fd = ::open(i2c_dev, O_RDWR | O_CLOEXEC);
+	if(this->fd < 0){
+		return -errno;
+	}
+
+	unsigned long funcs = 0;
+	this->plain_write = (ioctl(this->fd, I2C_FUNCS, &funcs) < 0) || !(funcs & I2C_FUNC_I2C);
+
+	if(this->plain_write && ioctl(this->fd, I2C_SLAVE, this->address >> 1) < 0){
+		int err = errno;
+		this->close();
+		return -err;
+	}
+
+	return 0;
+}
+
+void LCDTiny::close()
+{
+	if(this->fd >= 0){
+		::close(this->fd);
+		this->fd = -1;
+	}
+
+	this->mock = false;
+}
+
+int LCDTiny::write_expander(const uint8_t *buf, size_t len)
+{
+	this->bytes_sent += len;
+
+	if(this->mock){
+		return 0;
+	}
+
+	if(this->fd < 0){
+		return -EBADF;
+	}
+
+	if(this->plain_write){
+		return (::write(this->fd, buf, len) == static_cast<ssize_t>(len)) ? 0 : -errno;
+	}
+
+	struct i2c_msg msg;
+	msg.addr = this->address >> 1;
+	msg.flags = 0;
+	msg.len = static_cast<uint16_t>(len);
+	msg.buf = const_cast<uint8_t*>(buf);
+
+	struct i2c_rdwr_ioctl_data msgset;
+	msgset.msgs = &msg;
+	msgset.nmsgs = 1;
+
+	return (ioctl(this->fd, I2C_RDWR, &msgset) < 0) ? -errno : 0;
+}
+
+void LCDTiny::set_ready_deadline(uint32_t exec_us)
+{
+	clock_gettime(CLOCK_MONOTONIC, &this->ready_at);
+
+	this->ready_at.tv_nsec += static_cast<long>(exec_us) * 1000;
+	this->ready_at.tv_sec += this->ready_at.tv_nsec / NSEC_PER_SEC;
+	this->ready_at.tv_nsec %= NSEC_PER_SEC;
+}
+
+void LCDTiny::wait_ready_deadline()
+{
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &this->ready_at, nullptr) == EINTR);
+}
+
+int LCDTiny::send_8bit(uint8_t data)
+{
+	uint8_t data_arr[3] = {data, static_cast<uint8_t>(data | PIN_EN), static_cast<uint8_t>(data & ~PIN_EN)};
+
+	this->wait_ready_deadline();
+	int res = this->write_expander(data_arr, sizeof(data_arr));
+	this->set_ready_deadline(DELAY_COMMAND);
+
+	return res;
+}
+
+// Runs up to RUN_MAX_BYTES in one transaction (see LCD1602::send_data_run())
+int LCDTiny::send(const uint8_t *data, size_t len, uint8_t flags)
+{
+	uint8_t buf[RUN_MAX_BYTES * 4];
+
+	while(len){
+		size_t n = (len > RUN_MAX_BYTES) ? RUN_MAX_BYTES : len;
+
+		this->wait_ready_deadline();
+		int res = this->write_expander(buf, lcd_encode_4bit(data, n, flags | this->backlight_flag, buf));
+		this->set_ready_deadline(DELAY_COMMAND);
+
+		if(res < 0){
+			return res;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+// HD44780 datasheet figure 24: 4-bit mode activation, then 2 lines, 5x8 font
+int LCDTiny::init()
+{
+	int res;
+
+	if( (res = this->send_8bit(0b00110000)) < 0 ){
+		return res;
+	}
+	this->set_ready_deadline(DELAY_INIT_LONG);
+
+	if( (res = this->send_8bit(0b00110000)) < 0 ){
+		return res;
+	}
+	this->set_ready_deadline(DELAY_INIT_SHORT);
+
+	if( (res = this->send_8bit(0b00110000)) < 0 || (res = this->send_8bit(0b00100000)) < 0 ||
+		(res = this->send_command(LCD_FUNCTIONSET | LCD_2LINE)) < 0 ||
+		(res = this->return_home()) < 0 ||
+		(res = this->control(true)) < 0 ||
+		(res = this->send_command(LCD_ENTRYMODESET | LCD_ENTRYLEFT)) < 0 ){
+		return res;
+	}
+
+	return this->clear();
+}
+
+int LCDTiny::clear()
+{
+	int res = this->send_command(LCD_CLEARDISPLAY);
+	this->set_ready_deadline(DELAY_CLEAR);
+
+	this->current_row = 0;
+	this->current_col = 0;
+	return res;
+}
+
+int LCDTiny::return_home()
+{
+	int res = this->send_command(LCD_RETURNHOME);
+	this->set_ready_deadline(DELAY_CLEAR);
+
+	this->current_row = 0;
+	this->current_col = 0;
+	return res;
+}
+
+int LCDTiny::control(bool backlight, bool cursor, bool blink)
+{
+	this->backlight_flag = backlight ? 0x08 : 0x00;
+	this->display_control = (backlight ? LCD_DISPLAYON : 0) | (cursor ? LCD_CURSORON : 0) | (blink ? LCD_BLINKON : 0);
+
+	return this->send_command(LCD_DISPLAYCONTROL | this->display_control);
+}
+
+int LCDTiny::set_cursor(uint8_t row, uint8_t col)
+{
+	if(row > 1 || col >= NUM_COLS){
+		return -EINVAL;
+	}
+
+	this->current_row = row;
+	this->current_col = col;
+	return this->send_command(LCD_SETDDRAMADDR | (col + row * 0x40));
+}
+
+int LCDTiny::print(const char *str)
+{
+	return this->print_codes(reinterpret_cast<const uint8_t*>(str), strlen(str));
+}
+
+int LCDTiny::print_codes(const uint8_t *codes, size_t len)
+{
+	this->current_col += len;
+	return this->send(codes, len, PIN_RS);
+}
+
+int LCDTiny::user_char_create(uint8_t location, const uint8_t *charmap)
+{
+	if(location > 7){
+		return -EINVAL;
+	}
+
+	int res = this->send_command(LCD_SETCGRAMADDR | (location << 3));
+	if(res < 0){
+		return res;
+	}
+
+	res = this->send(charmap, 8, PIN_RS);
+
+	// Address counter points to CGRAM: back to the cursor
+	int pos = this->set_cursor(this->current_row, (this->current_col < NUM_COLS) ? this->current_col : NUM_COLS - 1);
+	return (res < 0) ? res : pos;
+}
@@ -0,0 +1,79 @@
+//
+// -- Description:
+// Small-footprint I2C 2x16 LCD driver (HD44780 + PCF8574(A)) for tiny embedded images
+//
+// -- Features:
+// 1. Builds without exceptions, RTTI and heap (make tiny): static storage, fixed buffers,
+//    error codes (negative errno) instead of exceptions
+// 2. Direct i2c-dev access (I2C_RDWR, plain write() fallback), no std::string / iostreams
+// 3. Same expander encoding as LCD1602 (lcd_encode_4bit()), data runs in one transaction
+// 4. Controller ready deadlines instead of fixed sleeps
+//
+// Character codes are sent as is (ASCII and ROM symbols, CGRAM locations 0-7).
+// Not thread-safe: one object per display, used by one thread (or under a mutex).
+//
+
+#ifndef _LCD_TINY_HPP
+#define _LCD_TINY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#ifndef PCF8574A_ADDR
+#define PCF8574A_ADDR   		0x7E
+#define PCF8574_ADDR    		0x4E
+#endif
+
+class LCDTiny
+{
+public:
+	explicit LCDTiny(uint8_t lcd_addr = PCF8574A_ADDR): address(lcd_addr){}
+	~LCDTiny() { this->close(); }
+
+	LCDTiny(const LCDTiny&) = delete;
+	LCDTiny& operator=(const LCDTiny&) = delete;
+
+	// Opens i2c device (e.g. /dev/i2c-0). nullptr - mock bus (nothing is sent).
+	// All methods return 0 or negative errno.
+	int open(const char *i2c_dev);
+	void close();
+
+	int init();
+	int clear();
+	int return_home();
+	int control(bool backlight, bool cursor = false, bool blink = false);
+	int set_cursor(uint8_t row, uint8_t col);
+	int print(const char *str);
+	int print_codes(const uint8_t *codes, size_t len);
+	int user_char_create(uint8_t location, const uint8_t *charmap);
+
+	uint8_t get_addr() const { return address; }
+	uint8_t get_current_row() const { return current_row; }
+	uint8_t get_current_col() const { return current_col; }
+	// Bytes sent to the expander (including mock bus)
+	size_t get_bytes_sent() const { return bytes_sent; }
+
+private:
+	uint8_t address;
+	int fd = -1;
+	bool mock = false;
+	bool plain_write = false;				// I2C_RDWR is not supported by the adapter
+
+	uint8_t backlight_flag = 0x08;
+	uint8_t display_control = 0;
+	uint8_t current_row = 0;
+	uint8_t current_col = 0;
+	size_t bytes_sent = 0;
+
+	struct timespec ready_at = {0, 0};
+
+	int write_expander(const uint8_t *buf, size_t len);
+	void set_ready_deadline(uint32_t exec_us);
+	void wait_ready_deadline();
+	int send_8bit(uint8_t data);
+	int send(const uint8_t *data, size_t len, uint8_t flags);
+	int send_command(uint8_t cmd) { return this->send(&cmd, 1, 0); }
+};
+
+#endif
@@ -1,13 +1,29 @@
 #include <iostream>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <system_error>
+#include <vector>
+#include <memory>
+#include <tuple>
+#include <cstdio>
 
 extern "C"{
 #include <unistd.h>		// sleep
+#include <signal.h>
+#include <sys/stat.h>	// mkdir
 }
 
 #include "i2c.hpp"
+#include "i2c_lock.hpp"
+#include "i2c_record.hpp"
+#include "i2c_scan.hpp"
 #include "lcd1602.hpp"
+#include "lcd_graphics.hpp"
+#include "lcd_state.hpp"
+#include "lcd_dashboard.hpp"
+#include "trace.hpp"
 
 #ifndef VERSION
 #define VERSION 	"1.1"
@@ -16,13 +32,16 @@ extern "C"{
 using namespace std;
 
 static void LCD_test(const string &i2c_device, int argc, char **argv);
+static int LCD_scan(bool identify);
+static void LCD_command(LCD1602 &lcd, const string &i2c_device, uint8_t lcd_addr, int cmd_idx, int argc, char **argv);
 
 void show_usage()
 {
 	cout << "-- LCD1602 util v." << VERSION << " --\n\n";
 
 	cout << "Call as following\n(provide i2c_device (as /dev/i2c-0) and [optional] i2c_address):\n\n";
-	cout << "./lcd_util <i2c_dev> [addr <dec_addr>] <command>\n\n";
+	cout << "./lcd_util <i2c_dev> [addr <dec_addr>] <command>\n";
+	cout << "./lcd_util scan [identify]\t- find displays on all adapters (identify - detect HD44780, needs R/W wired)\n\n";
 
 	cout << "List of supported commands:\n";
 	cout << "\\_ init\t\t\t- first time init LCD\n";
@@ -37,7 +56,12 @@ void show_usage()
 	cout << "\\_ autoscroll <0 | 1>\t- enable screen autoscroll\n";
 	cout << "\\_ set_c <row , col>\t- set cursor position\n";
 	cout << "\\_ print <str>\t\t- print string\n";
-	cout << "\\_ printwc <unicode>\t- print unicode character" << endl;
+	cout << "\\_ printwc <unicode>\t- print unicode character\n";
+	cout << "\\_ bignum <num>\t\t- print large 2-row number\n";
+	cout << "\\_ bar <val> <max>\t- print horizontal bar graph at cursor row\n";
+	cout << "\\_ calibrate [trials]\t- find minimal safe delays and save timings profile\n";
+	cout << "\\_ dashboard <config>\t- show values of files and pipes (see README)\n";
+	cout << "\\_ replay <file> [max]\t- replay recorded bus traffic (i2c_dev 'mock' - no bus)" << endl;
 }
 
 int main(int argc, char* argv[])
@@ -57,17 +81,114 @@ int main(int argc, char* argv[])
 		return 0;
 	}
 
+	if(!strcmp(argv[1], "scan")){
+		return LCD_scan( (argc > 2) && !strcmp(argv[2], "identify") );
+	}
+
 	string i2c_dev = argv[1];
 
+	// Chrome trace of the command: LCD_TRACE=<file.json>
+	const char *trace_path = getenv("LCD_TRACE");
+	if(trace_path){
+		trace::enable(true);
+	}
+
+	// Bus transport: LCD_TRANSPORT=<rdwr | write | smbus> (detected by adapter capabilities if not set)
+	const char *transport = getenv("LCD_TRANSPORT");
+	if(transport){
+		string t(transport);
+
+		if(t == "rdwr"){
+			hw::i2c_set_transport(hw::transport::RDWR);
+		}
+		else if(t == "write"){
+			hw::i2c_set_transport(hw::transport::WRITE);
+		}
+		else if(t == "smbus"){
+			hw::i2c_set_transport(hw::transport::SMBUS);
+		}
+		else{
+			cerr << "Unsupported transport: " << t << endl;
+			return 1;
+		}
+	}
+
+	// Bus traffic record of the command: LCD_RECORD=<file>
+	const char *record_path = getenv("LCD_RECORD");
+	if(record_path && !hw::i2c_record_start(record_path)){
+		cerr << "Unable to write record: " << record_path << endl;
+	}
+
+	int res = 0;
+
 	try{
 		LCD_test(i2c_dev, argc, argv);
 	}
 	catch(const exception &e){
 		cerr << e.what() << endl;
+		res = 1;
+	}
+
+	hw::i2c_record_stop();
+
+	if(trace_path && !trace::dump(trace_path)){
+		cerr << "Unable to write trace: " << trace_path << endl;
+	}
+
+	return res;
+}
+
+// Inventory: one line per responding address, tab separated
+static int LCD_scan(bool identify)
+{
+	vector<string> devs = hw::i2c_list_adapters();
+	if(devs.empty()){
+		cerr << "No i2c adapters found" << endl;
 		return 1;
 	}
 
-	return 0;
+	vector<hw::scan_result> results = hw::i2c_scan(devs, identify);
+	int res = 0;
+
+	cout << "#dev\taddr\tdec_addr\tchip\tdevice\tport\tbusy_address\n";
+
+	for(const hw::scan_result &r : results){
+		if( !r.error.empty() ){
+			cerr << r.dev << ": " << r.error << endl;
+			res = 1;
+			continue;
+		}
+
+		for(const hw::scan_device &d : r.devices){
+			int addr7 = d.addr >> 1;
+			const char *kind = (d.kind == hw::device_kind::HD44780) ? "hd44780" :
+				(d.kind == hw::device_kind::BUSY) ? "busy" : "unknown";
+			char line[128];
+
+			snprintf(line, sizeof(line), "%s\t0x%02x\t%d\t%s\t%s\t",
+				r.dev.c_str(), addr7, d.addr, (addr7 >= 0x38) ? "pcf8574a" : "pcf8574", kind);
+			cout << line;
+
+			if(d.kind == hw::device_kind::BUSY){
+				cout << "-\t-\n";
+				continue;
+			}
+
+			snprintf(line, sizeof(line), "0x%02x\t", d.port);
+			cout << line;
+
+			if(d.kind == hw::device_kind::HD44780){
+				snprintf(line, sizeof(line), "0x%02x", d.busy_address);
+				cout << line << "\n";
+			}
+			else{
+				cout << "-\n";
+			}
+		}
+	}
+
+	cout << flush;
+	return res;
 }
 
 static void LCD_test(const string &i2c_device, int argc, char **argv)
@@ -86,6 +207,25 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 	LCD1602 lcd(lcd_addr);
 	hw::i2c_init(i2c_device);
 
+	// Character ROM of the display: LCD_CHARSET=<a00 | a02 | wh1602b> (a00 by default)
+	const char *charset = getenv("LCD_CHARSET");
+	if(charset){
+		string c(charset);
+
+		if(c == "a00"){
+			lcd.set_charset(LCDCharset::Rom::A00);
+		}
+		else if(c == "a02"){
+			lcd.set_charset(LCDCharset::Rom::A02);
+		}
+		else if(c == "wh1602b"){
+			lcd.set_charset(LCDCharset::Rom::WH1602B);
+		}
+		else{
+			throw runtime_error("Unsupported charset: " + c);
+		}
+	}
+
 	if(argc <= cmd_idx){
 		cerr << "Invalid usage. See --help" << endl;
 		return;
@@ -93,6 +233,111 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 
 	string cmd{argv[cmd_idx]};
 
+	if(cmd == "replay"){
+		if(argc <= (cmd_idx + 1)){
+			cerr << "No record file provided for replay." << endl;
+			return;
+		}
+
+		bool max_speed = (argc > (cmd_idx + 2)) && (string(argv[cmd_idx + 2]) == "max");
+
+		// Replayed traffic changes the display behind the driver
+		if(i2c_device != "mock"){
+			try{
+				LCDStateFile(i2c_device, lcd_addr).invalidate();
+			}
+			catch(const exception &){
+			}
+		}
+
+		hw::replay_stats stats = hw::i2c_replay(argv[cmd_idx + 1], !max_speed, i2c_device == "mock");
+
+		cout << "transactions: " << stats.transactions << "\n";
+		cout << "bytes: " << stats.bytes << "\n";
+		cout << "elapsed: " << stats.elapsed_s << " s" << endl;
+		return;
+	}
+
+	// Driver state left by the previous calls, so they behave like one session
+	// (LCD_STATE=0 - don't use it). Without access to the state directory calls work
+	// without it silently, unless LCD_STATE is set explicitly.
+	const char *state_env = getenv("LCD_STATE");
+	unique_ptr<LCDStateFile> state;
+
+	auto state_warning = [state_env](const exception &e){
+		const system_error *se = dynamic_cast<const system_error*>(&e);
+		bool no_access = se && (se->code() == errc::permission_denied ||
+			se->code() == errc::read_only_file_system || se->code() == errc::operation_not_permitted);
+
+		if(state_env || !no_access){
+			cerr << "Driver state is not kept: " << e.what() << endl;
+		}
+	};
+
+	if( !(state_env && string(state_env) == "0") ){
+		try{
+			state.reset(new LCDStateFile(i2c_device, lcd_addr));
+			state->load(lcd);
+		}
+		catch(const exception &e){
+			state_warning(e);
+		}
+	}
+
+	// Dashboard runs for a long time: the state file and the bus are not held during it,
+	// its renders are locked one by one. Other calls see no valid state meanwhile.
+	bool long_running = (string(argv[cmd_idx]) == "dashboard");
+	bool keep_state = static_cast<bool>(state);
+
+	if(long_running){
+		state.reset();
+	}
+
+	// Other processes (daemons, other calls) don't use the display during the command
+	// (LCD_LOCK=0 - no locking). Lock is released by exit on errors.
+	const char *lock_env = getenv("LCD_LOCK");
+	hw::i2c_set_locking( !(lock_env && string(lock_env) == "0") );
+
+	if(hw::i2c_get_locking() && !long_running){
+		try{
+			hw::i2c_lock(lcd_addr);
+		}
+		catch(const exception &e){
+			cerr << "Bus is not locked: " << e.what() << endl;
+			hw::i2c_set_locking(false);
+		}
+	}
+
+	LCD_command(lcd, i2c_device, lcd_addr, cmd_idx, argc, argv);
+
+	// Display was used by other calls during the dashboard: no model is reliable
+	if(long_running && keep_state){
+		try{
+			state.reset(new LCDStateFile(i2c_device, lcd_addr));
+			if(state->is_valid()){
+				state->invalidate();
+				state.reset();
+			}
+		}
+		catch(const exception &e){
+			state_warning(e);
+		}
+	}
+
+	// Not reached on errors: the state stays invalid
+	if(state){
+		state->store(lcd);
+	}
+
+	if(hw::i2c_get_locking() && !long_running){
+		hw::i2c_unlock(lcd_addr);
+	}
+}
+
+static void LCD_command(LCD1602 &lcd, const string &i2c_device, uint8_t lcd_addr, int cmd_idx, int argc, char **argv)
+{
+	string cmd{argv[cmd_idx]};
+
 	if(cmd == "test"){
 		
 		lcd.init(lcd_addr);
@@ -153,7 +398,7 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 		}
 
 		cout << "Setting lcd backlight: " << on << endl;
-		lcd.control(on);
+		lcd.control(on, get<1>(lcd.get_control()), get<2>(lcd.get_control()));
 	} 
 	else if(cmd == "c"){	// Cursor
 		bool on = false;
@@ -163,7 +408,7 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 		}
 
 		cout << "Highlighting lcd cursor: " << on << endl;
-	    lcd.control(true, on);
+	    lcd.control(lcd.get_backlight_state(), on, get<2>(lcd.get_control()));
 	}
 	else if(cmd == "b"){	// Blinking cursor
 		bool on = false;
@@ -173,7 +418,7 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 		}
 
 		cout << "Setting lcd blink: " << on << endl;
-	    lcd.control(true, true, on);
+	    lcd.control(lcd.get_backlight_state(), get<1>(lcd.get_control()), on);
 	}
 	else if(cmd == "clear"){
 		lcd.clear();
@@ -241,6 +486,86 @@ static void LCD_test(const string &i2c_device, int argc, char **argv)
 		wchar_t wc = atoi(argv[3]); // symbol unicode
 		lcd.print_ru(wc);
 	}
+	else if(cmd == "calibrate"){
+		unsigned trials = 3;
+
+		if(argc > (cmd_idx + 1)){
+			char *end = nullptr;
+			long val = strtol(argv[cmd_idx + 1], &end, 10);
+
+			if(end == argv[cmd_idx + 1] || *end || val < 1 || val > 1000){
+				cerr << "Invalid number of trials: " << argv[cmd_idx + 1] << " (1..1000)" << endl;
+				return;
+			}
+			trials = static_cast<unsigned>(val);
+		}
+
+		cout << "Calibrating lcd timings (" << trials << " trials)..." << endl;
+		LCD1602::timings t = lcd.calibrate(trials);
+
+		cout << "command: " << t.command << " us\n";
+		cout << "clear: " << t.clear << " us\n";
+		cout << "init_long: " << t.init_long << " us\n";
+		cout << "init_short: " << t.init_short << " us" << endl;
+
+		string path = LCD1602::timings_path(i2c_device, lcd_addr);
+		mkdir(path.substr(0, path.rfind('/')).c_str(), 0755);
+
+		if( !LCD1602::save_timings(path, t) ){
+			cerr << "Unable to save timings profile: " << path << endl;
+			return;
+		}
+
+		cout << "Saved to: " << path << endl;
+	}
+	else if(cmd == "bignum"){
+		if(argc <= (cmd_idx + 1)){
+			cerr << "No number provided for bignum." << endl;
+			return;
+		}
+
+		LCDGraphics gfx(lcd);
+		gfx.big_number(0, 0, argv[cmd_idx + 1]);
+		gfx.render();
+	}
+	else if(cmd == "bar"){
+		if(argc <= (cmd_idx + 2)){
+			cerr << "No value or max provided for bar." << endl;
+			return;
+		}
+
+		LCDGraphics gfx(lcd);
+		gfx.hbar(lcd.get_current_row(), 0, lcd.get_num_cols(), atoi(argv[cmd_idx + 1]), atoi(argv[cmd_idx + 2]));
+		gfx.render();
+	}
+	else if(cmd == "dashboard"){
+		if(argc <= (cmd_idx + 1)){
+			cerr << "No config file provided for dashboard." << endl;
+			return;
+		}
+
+		LCDDashboard dashboard(lcd);
+		dashboard.load_config(argv[cmd_idx + 1]);
+
+		// Stopped by SIGINT / SIGTERM, so the driver state is saved
+		static LCDDashboard *active = nullptr;
+		active = &dashboard;
+		struct sigaction sa;
+		memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = [](int){ active->stop(); };
+		sigaction(SIGINT, &sa, nullptr);
+		sigaction(SIGTERM, &sa, nullptr);
+
+		dashboard.run();
+
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+
+		LCDDashboard::statistics stats = dashboard.get_statistics();
+		cout << "wakeups: " << stats.wakeups << "\n";
+		cout << "reads: " << stats.reads << "\n";
+		cout << "renders: " << stats.renders << endl;
+	}
 	else{
 		cerr << "Unsupported cmd: " << cmd << endl;
 		return;
@@ -0,0 +1,74 @@
+//
+// -- Description:
+// lcd_encode_4bit() check against the byte by byte send_4bit() formula (make test)
+//
+// Every byte value at every position of runs 0..40 bytes long (SIMD body and table tail)
+// with all RS / backlight combinations. Output past 4 * len must not be touched.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "lcd_encode.hpp"
+
+#define PIN_RS 		( (uint8_t)(1 << 0) )
+#define PIN_EN 		( (uint8_t)(1 << 2) )
+#define PIN_BL 		( (uint8_t)(1 << 3) )
+
+#define MAX_RUN 	40
+#define GUARD 		0xA5
+
+// send_4bit() before the bulk encoder
+static void reference(const uint8_t *data, size_t len, uint8_t flags, uint8_t *out)
+{
+	for(size_t i = 0; i < len; ++i){
+		uint8_t up = data[i] & 0xF0;
+		uint8_t lo = (data[i] << 4) & 0xF0;
+
+		out[i * 4 + 0] = up | flags | PIN_EN;
+		out[i * 4 + 1] = up | flags;
+		out[i * 4 + 2] = lo | flags | PIN_EN;
+		out[i * 4 + 3] = lo | flags;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	const uint8_t flag_sets[] = {0, PIN_RS, PIN_BL, PIN_RS | PIN_BL};
+
+	uint8_t data[MAX_RUN];
+	uint8_t expected[MAX_RUN * 4];
+	uint8_t out[MAX_RUN * 4 + 16];
+	unsigned long runs = 0, failures = 0;
+
+	for(uint8_t flags : flag_sets){
+		for(size_t len = 0; len <= MAX_RUN; ++len){
+			for(int start = 0; start < 256; ++start){
+				// Odd step: every value gets to every position
+				for(size_t i = 0; i < len; ++i){
+					data[i] = static_cast<uint8_t>(start + i * 37);
+				}
+
+				reference(data, len, flags, expected);
+				memset(out, GUARD, sizeof(out));
+
+				size_t bytes = lcd_encode_4bit(data, len, flags, out);
+				++runs;
+
+				bool ok = (bytes == len * 4) && (memcmp(out, expected, len * 4) == 0);
+				for(size_t i = len * 4; i < sizeof(out); ++i){
+					ok = ok && (out[i] == GUARD);
+				}
+
+				if( !ok && (failures++ < 10) ){
+					fprintf(stderr, "Mismatch: flags 0x%02X, len %zu, first byte 0x%02X\n", flags, len, len ? data[0] : 0);
+				}
+			}
+		}
+	}
+
+	printf("%s: %lu runs, %lu failed\n", (argc > 1) ? argv[1] : "lcd_encode_4bit", runs, failures);
+
+	return failures ? 1 : 0;
+}
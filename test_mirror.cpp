@@ -0,0 +1,207 @@
+//
+// -- Description:
+// LCDMirror checks on a modelled bus (make test)
+//
+// verify_step() reads the first member only, so the address counters of the other members
+// must be set back explicitly: the next output has to land in the same cells on every member.
+// Member with open circuit breaker is dropped from group output until rejoin().
+// Bus functions of i2c.hpp are replaced by HD44780 models behind PCF8574 expanders.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <map>
+
+#include "i2c.hpp"
+#include "lcd_mirror.hpp"
+
+#define PIN_RS 		( (uint8_t)(1 << 0) )
+#define PIN_RW 		( (uint8_t)(1 << 1) )
+#define PIN_EN 		( (uint8_t)(1 << 2) )
+
+// HD44780 in 4-bit mode (busy flag is never set)
+struct hd44780_model
+{
+	uint8_t ddram[0x80];
+	uint8_t cgram[0x40];
+	uint8_t port = 0;
+	uint8_t ac = 0;
+	bool cgram_ac = false;
+	bool increment = true;
+	bool mode_8bit = true;
+	bool low_nibble = false;		// next written nibble is the lower one
+	bool read_low = false;			// next read nibble is the lower one
+	uint8_t high = 0;
+	uint8_t read_value = 0;
+
+	hd44780_model() { memset(ddram, ' ', sizeof(ddram)); memset(cgram, 0, sizeof(cgram)); }
+
+	// 2-line mode: DDRAM rows are 0x00..0x27 and 0x40..0x67
+	void advance()
+	{
+		if(this->cgram_ac){
+			this->ac = (this->ac + (this->increment ? 1 : -1)) & 0x3F;
+		}
+		else if(this->increment){
+			this->ac = (this->ac == 0x27) ? 0x40 : (this->ac >= 0x67) ? 0x00 : (this->ac + 1);
+		}
+		else{
+			this->ac = (this->ac == 0x40) ? 0x27 : (this->ac == 0x00) ? 0x67 : (this->ac - 1);
+		}
+	}
+
+	void exec(uint8_t v, bool rs)
+	{
+		if(rs){
+			(this->cgram_ac ? this->cgram[this->ac & 0x3F] : this->ddram[this->ac & 0x7F]) = v;
+			this->advance();
+		}
+		else if(v & 0x80){ this->ac = v & 0x7F; this->cgram_ac = false; }
+		else if(v & 0x40){ this->ac = v & 0x3F; this->cgram_ac = true; }
+		else if(v & 0x20){ this->mode_8bit = v & 0x10; }
+		else if(v & 0x04){ this->increment = v & 0x02; }
+		else if(v & 0x02){ this->ac = 0; this->cgram_ac = false; }
+		else if(v & 0x01){ memset(this->ddram, ' ', sizeof(this->ddram)); this->ac = 0; this->cgram_ac = false; this->increment = true; }
+	}
+
+	void write(uint8_t b)
+	{
+		bool rise = !(this->port & PIN_EN) && (b & PIN_EN);
+		bool fall = (this->port & PIN_EN) && !(b & PIN_EN);
+
+		if(b & PIN_RW){
+			if(rise){
+				uint8_t v = (b & PIN_RS) ? (this->cgram_ac ? this->cgram[this->ac & 0x3F] : this->ddram[this->ac & 0x7F]) : (this->ac & 0x7F);
+				this->read_value = this->read_low ? ((v << 4) & 0xF0) : (v & 0xF0);
+			}
+			if(fall){
+				if(this->read_low && (b & PIN_RS)){
+					this->advance();
+				}
+				this->read_low = !this->read_low;
+			}
+		}
+		else if(fall){
+			uint8_t nibble = this->port & 0xF0;
+
+			if(this->mode_8bit){
+				this->exec(nibble, this->port & PIN_RS);
+			}
+			else if( !this->low_nibble ){
+				this->high = nibble;
+				this->low_nibble = true;
+			}
+			else{
+				this->low_nibble = false;
+				this->exec(this->high | (nibble >> 4), this->port & PIN_RS);
+			}
+		}
+
+		this->port = b;
+	}
+
+	uint8_t read() const
+	{
+		return ((this->port & PIN_RW) && (this->port & PIN_EN)) ? (this->read_value | (this->port & 0x0F)) : this->port;
+	}
+};
+
+static std::map<uint8_t, hd44780_model> bus_;
+static std::map<uint8_t, bool> breaker_open_;
+
+namespace hw{
+
+void i2c_init(const std::string &) {}
+std::string i2c_get_dev() { return "/dev/i2c-test"; }
+
+health i2c_get_health(uint8_t slave_address)
+{
+	health h;
+	h.open = breaker_open_[slave_address];
+	return h;
+}
+
+void i2c_write_byte(uint8_t slave_address, uint8_t byte)
+{
+	bus_[slave_address].write(byte);
+}
+
+void i2c_write_bytes(uint8_t slave_address, const uint8_t *buf, uint16_t len)
+{
+	for(uint16_t i = 0; i < len; ++i){
+		bus_[slave_address].write(buf[i]);
+	}
+}
+
+void i2c_write_multi(const uint8_t *slave_addresses, size_t num, const uint8_t *buf, uint16_t len)
+{
+	for(size_t n = 0; n < num; ++n){
+		i2c_write_bytes(slave_addresses[n], buf, len);
+	}
+}
+
+void i2c_read(uint8_t slave_address, uint16_t reg, uint8_t *buf, uint16_t len)
+{
+	bus_[slave_address].write(static_cast<uint8_t>(reg));
+	for(uint16_t i = 0; i < len; ++i){
+		buf[i] = bus_[slave_address].read();
+	}
+}
+
+} // namespace hw
+
+static int checks_ = 0;
+static int failures_ = 0;
+
+static void check(bool ok, const char *what)
+{
+	++checks_;
+	if( !ok ){
+		fprintf(stderr, "Failed: %s\n", what);
+		++failures_;
+	}
+}
+
+static bool same_ddram(uint8_t a, uint8_t b)
+{
+	return memcmp(bus_[a].ddram, bus_[b].ddram, sizeof(bus_[a].ddram)) == 0;
+}
+
+int main()
+{
+	LCDMirror group({PCF8574A_ADDR, PCF8574_ADDR});
+	group.init("/dev/i2c-test");
+
+	// Reads move the address counter of the first member only
+	group.print("ABCDEFGHIJKLMNOP");
+	group.verify_step(16);
+	group.print("Q");
+	check(same_ddram(PCF8574A_ADDR, PCF8574_ADDR), "output after verify_step() lands in the same cells");
+	check(bus_[PCF8574_ADDR].ddram[0] == 'A', "second member keeps its first cell");
+
+	// Repaired cell is rewritten on all members, following output stays in sync
+	bus_[PCF8574A_ADDR].ddram[3] = 'x';
+	size_t repaired = group.verify_step(0x80 + 0x40);		// whole DDRAM and CGRAM
+	group.print("R");
+	check(repaired == 1, "corrupted cell of the first member is repaired");
+	check(same_ddram(PCF8574A_ADDR, PCF8574_ADDR), "output after repair lands in the same cells");
+
+	// Member with open breaker gets no group output, it is repainted before rejoining
+	breaker_open_[PCF8574_ADDR] = true;
+	group.set_cursor(1, 0);
+	group.print("dropped");
+	check(bus_[PCF8574_ADDR].ddram[0x40] == ' ', "dropped member gets no group output");
+	check(group.is_dropped(1), "member with open breaker is dropped");
+
+	breaker_open_[PCF8574_ADDR] = false;
+	bus_[PCF8574_ADDR] = hd44780_model();		// power loss
+	group.rejoin(1);
+	group.print("!");
+	check(same_ddram(PCF8574A_ADDR, PCF8574_ADDR), "rejoined member is repainted");
+
+	printf("mirror: %d checks, %d failed\n", checks_, failures_);
+
+	return failures_ ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+// Small-footprint utility (make tiny): LCDTiny driver, stdio only
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "lcd_tiny.hpp"
+
+#ifndef VERSION
+#define VERSION 	"1.1"
+#endif
+
+static void show_usage()
+{
+	printf("-- LCD1602 tiny util v.%s --\n\n", VERSION);
+	printf("./lcd_tiny <i2c_dev | mock> [addr <dec_addr>] <command>\n\n");
+	printf("List of supported commands:\n");
+	printf("\\_ init\t\t\t- first time init LCD\n");
+	printf("\\_ bl <0 | 1>\t\t- disable backlight\n");
+	printf("\\_ clear\t\t- clear screen\n");
+	printf("\\_ home\t\t\t- return cursor to 0,0 position\n");
+	printf("\\_ set_c <row , col>\t- set cursor position\n");
+	printf("\\_ print <str>\t\t- print string\n");
+	printf("\\_ test\t\t\t- init and print test message\n");
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc < 3){
+		show_usage();
+		return 0;
+	}
+
+	uint8_t lcd_addr = PCF8574A_ADDR;
+	int cmd_idx = 2;
+
+	if((strcmp(argv[2], "addr") == 0) && (argc > 4)){
+		lcd_addr = static_cast<uint8_t>(atoi(argv[3]));
+		cmd_idx = 4;
+	}
+
+	// Static storage: no heap is used by the driver
+	static LCDTiny lcd(lcd_addr);
+
+	int res = lcd.open(strcmp(argv[1], "mock") ? argv[1] : nullptr);
+	if(res < 0){
+		fprintf(stderr, "open device '%s' failed: %s\n", argv[1], strerror(-res));
+		return 1;
+	}
+
+	const char *cmd = argv[cmd_idx];
+	const char *arg1 = (argc > cmd_idx + 1) ? argv[cmd_idx + 1] : nullptr;
+	const char *arg2 = (argc > cmd_idx + 2) ? argv[cmd_idx + 2] : nullptr;
+
+	if(strcmp(cmd, "init") == 0){
+		res = lcd.init();
+	}
+	else if(strcmp(cmd, "bl") == 0){
+		res = lcd.control(arg1 && atoi(arg1));
+	}
+	else if(strcmp(cmd, "clear") == 0){
+		res = lcd.clear();
+	}
+	else if(strcmp(cmd, "home") == 0){
+		res = lcd.return_home();
+	}
+	else if(strcmp(cmd, "set_c") == 0 && arg2){
+		res = lcd.set_cursor(static_cast<uint8_t>(atoi(arg1)), static_cast<uint8_t>(atoi(arg2)));
+	}
+	else if(strcmp(cmd, "print") == 0 && arg1){
+		res = lcd.print(arg1);
+	}
+	else if(strcmp(cmd, "test") == 0){
+		if( (res = lcd.init()) == 0 && (res = lcd.print("LCD1602 tiny")) == 0 &&
+			(res = lcd.set_cursor(1, 0)) == 0 ){
+			res = lcd.print(VERSION);
+		}
+		printf("bytes sent: %zu\n", lcd.get_bytes_sent());
+	}
+	else{
+		fprintf(stderr, "Unsupported cmd: %s\n", cmd);
+		return 1;
+	}
+
+	if(res < 0){
+		fprintf(stderr, "%s failed: %s\n", cmd, strerror(-res));
+		return 1;
+	}
+
+	return 0;
+}
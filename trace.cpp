@@ -0,0 +1,186 @@
+#include <mutex>
+#include <vector>
+#include <thread>
+#include <cstdio>
+#include <csignal>
+
+extern "C"{
+#include <unistd.h>
+#include <time.h>
+#include <sys/syscall.h>
+}
+
+#include "trace.hpp"
+
+namespace trace{
+
+std::atomic<bool> enabled_ { false };
+
+// Event slot is guarded by sequence counter (odd - being written), so dump can
+// run concurrently with writers without locks
+struct event
+{
+	std::atomic<uint32_t> seq;
+	std::atomic<const char*> name;
+	std::atomic<const char*> cat;
+	std::atomic<uint64_t> begin;
+	std::atomic<uint64_t> end;
+};
+
+struct ring
+{
+	long tid = 0;
+	std::atomic<uint64_t> head { 0 };	// number of recorded events
+	event events[TRACE_RING_SIZE];
+};
+
+static std::mutex registry_mutex_;			// guards rings_ only (once per thread)
+static std::vector<ring*> rings_;
+static thread_local ring *local_ring_ = nullptr;
+
+static std::mutex signal_mutex_;			// guards signal_path_
+static std::string signal_path_;
+static int signal_pipe_[2] = {-1, -1};
+
+void enable(bool on)
+{
+	enabled_.store(on, std::memory_order_relaxed);
+}
+
+uint64_t now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Rings are never freed: events of finished threads stay available for dump
+static ring* get_ring()
+{
+	if( !local_ring_ ){
+		ring *r = new ring();
+		r->tid = syscall(SYS_gettid);
+
+		for(auto &ev : r->events){
+			ev.seq.store(0, std::memory_order_relaxed);
+		}
+
+		std::lock_guard<std::mutex> lck(registry_mutex_);
+		rings_.push_back(r);
+		local_ring_ = r;
+	}
+
+	return local_ring_;
+}
+
+void record(const char *name, const char *cat, uint64_t begin_ns, uint64_t end_ns)
+{
+	ring *r = get_ring();
+	uint64_t idx = r->head.load(std::memory_order_relaxed);
+	event &ev = r->events[idx % TRACE_RING_SIZE];
+
+	uint32_t seq = ev.seq.load(std::memory_order_relaxed);
+	ev.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	ev.name.store(name, std::memory_order_relaxed);
+	ev.cat.store(cat, std::memory_order_relaxed);
+	ev.begin.store(begin_ns, std::memory_order_relaxed);
+	ev.end.store(end_ns, std::memory_order_relaxed);
+
+	ev.seq.store(seq + 2, std::memory_order_release);
+	r->head.store(idx + 1, std::memory_order_release);
+}
+
+bool dump(const std::string &path)
+{
+	std::vector<ring*> rings;
+	{
+		std::lock_guard<std::mutex> lck(registry_mutex_);
+		rings = rings_;
+	}
+
+	FILE *fp = fopen(path.c_str(), "w");
+	if( !fp ){
+		return false;
+	}
+
+	long pid = getpid();
+	bool first = true;
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+	for(ring *r : rings){
+		uint64_t head = r->head.load(std::memory_order_acquire);
+		uint64_t from = (head > TRACE_RING_SIZE) ? (head - TRACE_RING_SIZE) : 0;
+
+		for(uint64_t i = from; i < head; ++i){
+			event &ev = r->events[i % TRACE_RING_SIZE];
+
+			uint32_t seq = ev.seq.load(std::memory_order_acquire);
+			if(seq & 1){
+				continue;
+			}
+
+			const char *name = ev.name.load(std::memory_order_relaxed);
+			const char *cat = ev.cat.load(std::memory_order_relaxed);
+			uint64_t begin = ev.begin.load(std::memory_order_relaxed);
+			uint64_t end = ev.end.load(std::memory_order_relaxed);
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if(ev.seq.load(std::memory_order_relaxed) != seq){
+				continue;	// overwritten while reading
+			}
+
+			fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld}",
+				first ? "" : ",", name, cat, begin / 1000.0, (end - begin) / 1000.0, pid, r->tid);
+			first = false;
+		}
+	}
+
+	fprintf(fp, "\n]}\n");
+
+	return fclose(fp) == 0;
+}
+
+static void signal_handler(int)
+{
+	char c = 1;
+	ssize_t res = write(signal_pipe_[1], &c, 1);
+	(void)res;
+}
+
+bool dump_on_signal(int signo, const std::string &path)
+{
+	std::lock_guard<std::mutex> lck(signal_mutex_);
+
+	if(signal_pipe_[0] < 0){
+		if(pipe(signal_pipe_) < 0){
+			return false;
+		}
+
+		// Dumping thread lives until process exit
+		std::thread([]{
+			char c;
+			while(read(signal_pipe_[0], &c, 1) > 0){
+				std::string path;
+				{
+					std::lock_guard<std::mutex> lck(signal_mutex_);
+					path = signal_path_;
+				}
+				dump(path);
+			}
+		}).detach();
+	}
+
+	signal_path_ = path;
+
+	struct sigaction sa = {};
+	sa.sa_handler = signal_handler;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	return sigaction(signo, &sa, nullptr) == 0;
+}
+
+} // namespace trace
@@ -0,0 +1,80 @@
+//
+// -- Description:
+// Lightweight tracing of display and bus activity with Chrome trace JSON export
+// (open with chrome://tracing or https://ui.perfetto.dev)
+//
+// -- Features:
+// 1. RAII spans (TRACE_SPAN macro) recorded into lock-free per-thread ring buffers
+// 2. Runtime enable / disable: disabled span costs one atomic load
+// 3. Dump on demand: API call or signal (e.g. SIGUSR1)
+//
+// Build with -DLCD_NO_TRACE to compile tracing out completely.
+//
+
+#ifndef _TRACE_HPP
+#define _TRACE_HPP
+
+#include <cstdint>
+#include <string>
+#include <atomic>
+
+namespace trace{
+
+// Events stored per thread (older ones are overwritten)
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 		4096
+#endif
+
+extern std::atomic<bool> enabled_;
+
+#ifdef LCD_NO_TRACE
+inline bool enabled() { return false; }
+#else
+inline bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+#endif
+void enable(bool on);
+
+// Monotonic time in nanoseconds
+uint64_t now_ns();
+
+// Record complete event [begin_ns, end_ns). name and cat must be string literals.
+void record(const char *name, const char *cat, uint64_t begin_ns, uint64_t end_ns);
+
+// Write all recorded events as Chrome trace JSON. Returns false on file error.
+bool dump(const std::string &path);
+
+// Dump to path when signo is received. Dumping is done by a helper thread,
+// signal handler only wakes it up.
+bool dump_on_signal(int signo, const std::string &path);
+
+class span
+{
+public:
+	span(const char *name, const char *cat): name(name), cat(cat), begin(enabled() ? now_ns() : 0) {}
+	~span() {
+		if(this->begin){
+			record(this->name, this->cat, this->begin, now_ns());
+		}
+	}
+
+	span(const span&) = delete;
+	span& operator=(const span&) = delete;
+
+private:
+	const char *name;
+	const char *cat;
+	uint64_t begin;
+};
+
+} // namespace trace
+
+#define TRACE_CONCAT_(a, b) 	a##b
+#define TRACE_CONCAT(a, b) 		TRACE_CONCAT_(a, b)
+
+#ifdef LCD_NO_TRACE
+#define TRACE_SPAN(name, cat)
+#else
+#define TRACE_SPAN(name, cat) 	trace::span TRACE_CONCAT(trace_span_, __LINE__)(name, cat)
+#endif
+
+#endif